@@ -7,6 +7,10 @@
 #include "cmd/input.h"
 #include "cmd/filter.h"
 #include "cmd/export.h"
+#include "cmd/watch.h"
+#include "cmd/profile.h"
+#include "cmd/compact.h"
+#include "cmd/query.h"
 
 namespace cli {
     // Base help is here instead of cmd/help.cpp since it does not correspond
@@ -30,6 +34,10 @@ Commands:
     filter             Manage file filters
     import             Import files from input directories
     export             Export imported files into a given directory
+    watch              Import new files as they appear in input directories
+    profile            Tune the project database for durability or speed
+    compact            Make identical files in the project share their data
+    query              Run an SQL query over the project and its folders
 
 Use `repaintbrush help <command> to get further information about a command.`)";
     void base_help()
@@ -37,13 +45,101 @@ Use `repaintbrush help <command> to get further information about a command.`)";
         std::cout << base_help_string << std::endl;
     }
 
+    const std::vector<ArgParse> transfer_arg_definitions = {
+        {"mode", true, 'm'},
+        {"jobs", true, 'j'},
+        {"queue", true, {}},
+        {"engine", true, {}}
+    };
+
+    bool get_count_option(const ArgBlock& block, const std::string& name,
+        size_t& value)
+    {
+        if (!block.has_option(name)) {
+            return true;
+        }
+        const std::string& str = block.get_option(name);
+        try {
+            size_t pos;
+            unsigned long ret = std::stoul(str, &pos, 10);
+            if (pos == str.size() && ret > 0) {
+                value = ret;
+                return true;
+            }
+        } catch (...) {}
+        std::cout << "--" << name << " must be a positive integer." << std::endl;
+        return false;
+    }
+
+    bool get_transfer_options(const ArgBlock& block,
+        core::TransferOptions& options)
+    {
+        if (block.has_option("mode")) {
+            auto mode = core::get_transfer_by_name(block.get_option("mode"));
+            if (!mode) {
+                std::cout << "Unknown transfer mode '"
+                          << block.get_option("mode") << "'. Valid modes are "
+                             "copy, reflink, range, hardlink and symlink."
+                          << std::endl;
+                return false;
+            }
+            options.mode = *mode;
+        }
+        if (block.has_option("engine")) {
+            const std::string& engine = block.get_option("engine");
+            if (engine == "threads") {
+                options.engine = core::ENGINE_THREADS;
+            } else if (engine == "uring") {
+                options.engine = core::ENGINE_URING;
+            } else {
+                std::cout << "Unknown engine '" << engine << "'. Valid "
+                             "engines are threads and uring." << std::endl;
+                return false;
+            }
+        }
+        size_t workers = options.workers;
+        if (!get_count_option(block, "jobs", workers)
+        || !get_count_option(block, "queue", options.queue_depth)
+        || !get_count_option(block, "batch", options.batch_size)) {
+            return false;
+        }
+        options.workers = workers;
+        return true;
+    }
+
+    bool get_duplicates_option(const ArgBlock& block,
+        core::TransferOptions& options)
+    {
+        if (!block.has_option("duplicates")) {
+            return true;
+        }
+        const std::string& duplicates = block.get_option("duplicates");
+        if (duplicates == "copy") {
+            options.duplicates = core::DUPLICATE_COPY;
+        } else if (duplicates == "skip") {
+            options.duplicates = core::DUPLICATE_SKIP;
+        } else if (duplicates == "link") {
+            options.duplicates = core::DUPLICATE_LINK;
+        } else {
+            std::cout << "Unknown duplicate handling '" << duplicates
+                      << "'. Valid choices are copy, skip and link."
+                      << std::endl;
+            return false;
+        }
+        return true;
+    }
+
     const std::map<std::string, Command> command_definitions = {
         {  "help", {  command_help_func,   command_help_string}},
         {  "init", {  command_init_func,   command_init_string}},
         { "input", { command_input_func,  command_input_string}},
         {"import", {command_import_func, command_import_string}},
         {"filter", {command_filter_func, command_filter_string}},
-        {"export", {command_export_func, command_export_string}}
+        {"export", {command_export_func, command_export_string}},
+        { "watch", { command_watch_func,  command_watch_string}},
+        {"profile", {command_profile_func, command_profile_string}},
+        {"compact", {command_compact_func, command_compact_string}},
+        {  "query", {  command_query_func,   command_query_string}}
     };
 
     void base(const std::vector<std::string>& args)
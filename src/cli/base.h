@@ -3,6 +3,7 @@
 #include <string>
 #include <functional>
 #include "arg.h"
+#include "../core/pipeline.h"
 
 namespace cli {
     struct Command {
@@ -13,5 +14,26 @@ namespace cli {
     extern const std::map<std::string, Command> command_definitions;
 
     void base_help();
+
+    /// Read a positive integer option into value.
+    /// Leaves value untouched if the option was not given. Prints an error
+    /// and returns false if the option is not a positive integer.
+    bool get_count_option(const ArgBlock& block, const std::string& name,
+        size_t& value);
+
+    /// Options accepted by commands that transfer files.
+    extern const std::vector<ArgParse> transfer_arg_definitions;
+
+    /// Read the transfer options of a command into options, along with
+    /// --batch for commands that accept it.
+    /// Options that were not given are left untouched. Prints an error and
+    /// returns false if any of the given options are not valid.
+    bool get_transfer_options(const ArgBlock& block,
+        core::TransferOptions& options);
+    /// Read the --duplicates option of an import into options.
+    /// Leaves options untouched if the option was not given. Prints an
+    /// error and returns false if it is not valid.
+    bool get_duplicates_option(const ArgBlock& block,
+        core::TransferOptions& options);
     void init(const std::vector<std::string>& args);
 }
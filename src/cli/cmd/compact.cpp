@@ -0,0 +1,61 @@
+#include "compact.h"
+#include <iostream>
+#include "../../core/project.h"
+
+namespace cli {
+    const char* command_compact_string =
+R"(Usage: repaintbrush compact [-j n] [-n] [--hardlink] [-f]
+
+Find files in the project folder with identical contents, and make them share
+their data so that it is only stored once.
+
+Options:
+    -f, --force            Force opening of the project
+    -j, --jobs <n>         Number of files to hash at once
+    -n, --dry-run          Only report what would be compacted
+    --hardlink             Always create hard links instead of reflinks
+
+Identical files are replaced by reflinks, which need a copy-on-write file
+system such as btrfs or XFS. Reflinked files stay separate files, and writing
+to one never changes the other. With --hardlink, identical files are always
+hard linked, even on file systems that support reflinks. Hard links work on
+any file system, but editors that save over a file in place then change every
+linked file.)";
+
+    void command_compact_func(ArgChain& args)
+    {
+        ArgBlock block = args.parse(0, false, {
+            {"force", false, 'f'},
+            {"jobs", true, 'j'},
+            {"dry-run", false, 'n'},
+            {"hardlink", false, {}}
+        });
+        args.assert_finished();
+        size_t jobs = 0;
+        if (!get_count_option(block, "jobs", jobs)) return;
+        auto mode = block.has_option("hardlink")
+            ? core::TRANSFER_HARDLINK : core::TRANSFER_REFLINK;
+        bool dry_run = block.has_option("dry-run");
+
+        bool force = block.has_option("force");
+        auto project = core::get_project(force);
+        if (!project) return;
+
+        auto result = project->compact(mode, jobs, dry_run);
+        std::cout << "Found " << result.duplicates << " duplicates of "
+                  << result.groups << " files among " << result.files
+                  << " files." << std::endl;
+        if (dry_run) {
+            std::cout << "Compacting would reclaim " << result.reclaimed
+                      << " bytes." << std::endl;
+            return;
+        }
+        std::cout << "Linked " << result.linked << " files, reclaiming "
+                  << result.reclaimed << " bytes." << std::endl;
+        if (result.unsupported) {
+            std::cout << "The file system does not support reflinks. "
+                         "Use --hardlink to create hard links instead."
+                      << std::endl;
+        }
+    }
+}
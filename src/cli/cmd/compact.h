@@ -0,0 +1,8 @@
+#pragma once
+#include "../base.h"
+#include "../arg.h"
+
+namespace cli {
+    extern const char* command_compact_string;
+    void command_compact_func(ArgChain& args);
+}
@@ -4,23 +4,45 @@
 
 namespace cli {
     const char* command_export_string =
-R"(Usage repaintbrush export [-f] folder
+R"(Usage repaintbrush export [-m mode] [-j n] [-f] folder
 
 Export all images into a folder.
 
 Options:
-    -f, --force    Force opening of a project.)";
+    -f, --force            Force opening of a project.
+    -m, --mode <mode>      How files are placed into the folder.
+    -j, --jobs <n>         Number of files to transfer at once.
+    --queue <n>            Number of files queued up for transfer.
+    --engine <engine>      Transfer with a pool of threads (default), or
+                           with io_uring.
+
+Transfer modes:
+    copy           Copy every file (default)
+    reflink        Clone files on copy-on-write file systems such as btrfs or
+                   XFS, so that no data is copied
+    range          Copy files inside of the kernel
+    hardlink       Create hard links to files
+    symlink        Create symbolic links to files
+
+Modes that are not supported by the file system fall back to a copy.)";
 
     void command_export_func(ArgChain& args)
     {
-        ArgBlock block = args.parse(1, true, {
+        std::vector<ArgParse> argdefs = {
             {"force", false, 'f'}
-        });
+        };
+        argdefs.insert(argdefs.end(), transfer_arg_definitions.begin(),
+            transfer_arg_definitions.end());
+        ArgBlock block = args.parse(1, true, argdefs);
         block.assert_all_args();
         args.assert_finished();
+        core::TransferOptions options;
+        if (!get_transfer_options(block, options)) return;
 
         bool force = block.has_option("force");
-        auto project = core::get_project(force);
+        // Exporting only ever reads registered files that still exist, so
+        // there is no need to check for removed files first.
+        auto project = core::get_project(force, false);
         if (!project) return;
 
         // std::cout << fs::weakly_canonical(block[0]) << std::endl;
@@ -36,7 +58,7 @@ Options:
             return;
         }
         fs::create_directories(exportpath);
-        auto result = project->export_to_folder(exportpath);
+        auto result = project->export_to_folder(exportpath, options);
         std::cout << "Successfully exported " << result.files
                   << " files." << std::endl;
         std::cout << "Filtered out " << result.filtered
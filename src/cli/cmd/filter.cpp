@@ -54,7 +54,7 @@ Options:
         block.assert_least_num_args(2);
         args.assert_finished();
         bool force = block.has_option("force");
-        auto project = core::get_project(force);
+        auto project = core::get_project(force, false);
         if (!project) return;
 
         core::Project::filter_t filter_type;
@@ -84,6 +84,7 @@ Options:
                           << "' for filter type '" << filter_name << "'"
                           << std::endl;
             }
+            return;
         }
         project->add_filter(filter_type, filter);
         std::cout << "Successfully added filter" << std::endl;
@@ -103,6 +104,28 @@ Options:
 R"(Filter Types:
     mipmap         Filter all files that end with _mipN where N is a number.
     type <type>    Filer all files with the file extension <type>.
+    path <path>    Filter all files inside of the relative folder <path>.
+    glob <glob>    Filter all files whose name matches <glob>, such as
+                   tex1_4x4_*. Supports *, ? and [...].
+    regex <regex>  Filter all files whose whole name matches the regular
+                   expression <regex>.
+    format <fmt>   Filter all Dolphin textures of the format <fmt>, which is
+                   one of i4, i8, ia4, ia8, rgb565, rgb5a3, rgba8, c4, c8,
+                   c14x2 or cmpr.
+    texsize <WxH>  Filter all Dolphin textures no larger than <WxH> in the
+                   game, as written in their names.
+    size <WxH>     Filter all images no larger than <WxH>, such as 8x8.
+    npot           Filter all images whose width or height is not a power of
+                   two.
+    opaque         Filter all images without an alpha channel.
+    paletted       Filter all images that use a color palette.
+    solid          Filter all images that are a single color, or are fully
+                   transparent.
+
+Filters on images only read the header of each image, except for solid,
+which decodes the image. Both are remembered until the image changes.
+Names of registered images are parsed when they are imported, so mipmap,
+format and texsize filters are looked up in the database on export.
 )";
     void command_filter_list(ArgChain& args)
     {
@@ -117,7 +140,7 @@ R"(Filter Types:
         }
 
         bool force = block.has_option("force");
-        auto project = core::get_project(force);
+        auto project = core::get_project(force, false);
         if (!project) return;
 
         auto filter_list = project->get_filters();
@@ -154,7 +177,7 @@ R"(Filter Types:
         args.assert_finished();
 
         bool force = block.has_option("force");
-        auto project = core::get_project(force);
+        auto project = core::get_project(force, false);
         if (!project) return;
 
         int id;
@@ -4,21 +4,59 @@
 
 namespace cli {
     const char* command_import_string =
-R"(Usage: repaintbrush import [-i input] [-f] <target>
+R"(Usage: repaintbrush import [-i input] [-m mode] [-j n] [-f] <target>
 
 Import input images into the target folder.
 
 Options:
     -f, --force            Force opening of the project
-    -i, --input <input>    Only import from the given input folder)";
+    -i, --input <input>    Only import from the given input folder
+    -m, --mode <mode>      How files are placed into the target folder
+    -j, --jobs <n>         Number of files to transfer at once
+    --queue <n>            Number of files queued up for transfer
+    --engine <engine>      Transfer with a pool of threads (default), or
+                           with io_uring
+    --batch <n>            Number of transferred files to commit at once
+    --duplicates <how>     What to do with files whose contents are already
+                           registered under another name
+
+Transfer modes:
+    copy           Copy every file (default)
+    reflink        Clone files on copy-on-write file systems such as btrfs or
+                   XFS, so that no data is copied
+    range          Copy files inside of the kernel
+    hardlink       Create hard links to files
+    symlink        Create symbolic links to files
+
+Modes that are not supported by the file system fall back to a copy.
+
+Duplicates:
+    copy           Copy duplicates like any other file (default)
+    skip           Register duplicates without copying them, so that they
+                   are neither stored nor exported
+    link           Hard link duplicates to the image they duplicate. Editors
+                   that save over a file in place change both files.
+
+Files are hashed as they are copied. When duplicates are skipped or linked,
+every file is hashed before anything is transferred instead, so that
+duplicates are never copied. With other transfer modes, files are only
+hashed when duplicates are skipped or linked.)";
 
     void command_import_func(ArgChain& args)
     {
-        ArgBlock block = args.parse(1, false, {
+        std::vector<ArgParse> argdefs = {
             {"force", false, 'f'},
-            {"input", true, 'i'}
-        });
+            {"input", true, 'i'},
+            {"batch", true, {}},
+            {"duplicates", true, {}}
+        };
+        argdefs.insert(argdefs.end(), transfer_arg_definitions.begin(),
+            transfer_arg_definitions.end());
+        ArgBlock block = args.parse(1, false, argdefs);
         args.assert_finished();
+        core::TransferOptions options;
+        if (!get_transfer_options(block, options)) return;
+        if (!get_duplicates_option(block, options)) return;
         // get import folder
         boost::optional<fs::path> import_folder;
         if (block.has_option("input")) {
@@ -35,7 +73,7 @@ Options:
         if (!project) return;
 
         // copy files
-        auto result = project->import(export_folder, import_folder);
+        auto result = project->import(export_folder, import_folder, options);
 
         // Report information back to user.
         if (result.folders == 0) {
@@ -48,6 +86,10 @@ Options:
         } else {
             std::cout << "Successfully imported " << result.files << " files"
                       << std::endl;
+            if (result.duplicates > 0) {
+                std::cout << "Found " << result.duplicates
+                          << " duplicates." << std::endl;
+            }
             std::cout << "Filtered out " << result.filtered
                       << " results." << std::endl;
         }
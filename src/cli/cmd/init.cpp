@@ -23,17 +23,12 @@ Options:
             path_base = block[0];
         }
         auto path_project = path_base / core::rbrush_folder_name;
-        // Create project folder
+        // Make sure project does not already exist
         if (fs::exists(path_project)) {
             std::cout << "Could not create project; project already exists."
                       << std::endl;
             return;
         }
-        fs::create_directories(path_project);
-        // Create version file
-        fs::ofstream file_version(path_project / core::rbrush_version_name);
-        file_version << core::version;
-        file_version.close();
         // Create project
         bool do_force = block.has_option("force");
         auto project = core::Project::create(path_base, do_force);
@@ -47,7 +47,7 @@ Commands:
         block.assert_all_args();
         args.assert_finished();
         auto force = block.has_option("force");
-        auto project = core::get_project(force);
+        auto project = core::get_project(force, false);
         if (!project) return;
 
         fs::path inputpath = block[0];
@@ -67,7 +67,7 @@ Commands:
         block.assert_all_args();
         args.assert_finished();
         auto force = block.has_option("force");
-        auto project = core::get_project(force);
+        auto project = core::get_project(force, false);
         if (!project) return;
 
         fs::path inputpath = block[0];
@@ -87,7 +87,7 @@ Commands:
         block.assert_all_args();
         args.assert_finished();
         bool force = block.has_option("force");
-        auto project = core::get_project(force);
+        auto project = core::get_project(force, false);
         if (!project) return;
         auto list = project->list_input_folders();
         if (list.size() == 0) {
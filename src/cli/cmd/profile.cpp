@@ -0,0 +1,134 @@
+#include "profile.h"
+#include <iostream>
+#include <iomanip>
+#include "../../core/project.h"
+
+namespace cli {
+    const char* command_profile_string =
+R"(Usage: repaintbrush profile show [-f]
+   or: repaintbrush profile list
+   or: repaintbrush profile use [-f] <preset>
+   or: repaintbrush profile set [-f] <setting> <value>
+
+Manage how a project's database trades durability for speed. The profile is
+stored in the project, and applied every time the project is opened.
+
+Subcommands:
+    show           Show the settings of the project's profile.
+    list           List all preset profiles.
+    use            Switch to a preset profile.
+    set            Change a single setting of the project's profile.
+
+Presets:
+    default        SQLite's defaults: a rollback journal, and every commit is
+                   synced to disk.
+    durable        Write-ahead log, and every commit is synced to disk.
+                   Checkpoints happen in the background.
+    bulk           Write-ahead log, memory mapped reads, a large cache and
+                   in-memory temporary tables. Recent commits may be lost on
+                   power failure, but the project is never corrupted.
+                   Best for importing large numbers of files.
+
+Settings:
+    journal_mode           delete, truncate, persist or wal
+    synchronous            off, normal, full or extra
+    mmap_size              Bytes of the database to memory map
+    cache_size             Pages to cache, or KiB to cache if negative.
+                           A value such as 2000k also means 2000 KiB
+    temp_store             default, file or memory
+    checkpoint_interval    Milliseconds between background checkpoints in
+                           wal mode, or 0 to checkpoint while committing
+
+Options:
+    -f, --force    Force opening of the project.)";
+
+    void command_profile_show(ArgChain& args);
+    void command_profile_list(ArgChain& args);
+    void command_profile_use(ArgChain& args);
+    void command_profile_set(ArgChain& args);
+
+    void command_profile_func(ArgChain& args)
+    {
+        ArgBlock block = args.parse(1, true, {});
+        block.assert_all_args();
+        const std::string& cmd = block[0];
+        if (cmd == "show") {
+            command_profile_show(args);
+        } else if (cmd == "list") {
+            command_profile_list(args);
+        } else if (cmd == "use") {
+            command_profile_use(args);
+        } else if (cmd == "set") {
+            command_profile_set(args);
+        } else {
+            std::cout << "Unrecognized command 'profile "
+                      << cmd << "'" << std::endl;
+        }
+    }
+
+    void print_profile(const core::PerformanceProfile& profile)
+    {
+        for (const auto& key : core::get_profile_keys()) {
+            std::cout << "    " << std::left << std::setw(23) << key
+                      << core::get_profile_value(profile, key) << std::endl;
+        }
+    }
+
+    void command_profile_show(ArgChain& args)
+    {
+        ArgBlock block = args.parse(0, false, {
+            {"force", false, 'f'}
+        });
+        args.assert_finished();
+        bool force = block.has_option("force");
+        auto project = core::get_project(force, false);
+        if (!project) return;
+        std::cout << "Profile: " << project->get_profile_name() << std::endl;
+        print_profile(project->get_profile());
+    }
+
+    void command_profile_list(ArgChain& args)
+    {
+        ArgBlock block = args.parse(0, false, {});
+        args.assert_finished();
+        for (const auto& preset : core::get_profile_presets()) {
+            std::cout << preset.first << std::endl;
+            print_profile(preset.second);
+        }
+    }
+
+    void command_profile_use(ArgChain& args)
+    {
+        ArgBlock block = args.parse(1, false, {
+            {"force", false, 'f'}
+        });
+        block.assert_all_args();
+        args.assert_finished();
+        auto profile = core::get_profile_preset(block[0]);
+        if (!profile) {
+            std::cout << "No such profile '" << block[0] << "'." << std::endl;
+            return;
+        }
+        bool force = block.has_option("force");
+        auto project = core::get_project(force, false);
+        if (!project) return;
+        project->set_profile(block[0], *profile);
+        std::cout << "Now using the " << block[0] << " profile." << std::endl;
+    }
+
+    void command_profile_set(ArgChain& args)
+    {
+        ArgBlock block = args.parse(2, false, {
+            {"force", false, 'f'}
+        });
+        block.assert_all_args();
+        args.assert_finished();
+        bool force = block.has_option("force");
+        auto project = core::get_project(force, false);
+        if (!project) return;
+        auto profile = project->get_profile();
+        core::set_profile_value(profile, block[0], block[1]);
+        project->set_profile(core::custom_profile_name, profile);
+        std::cout << "Successfully changed " << block[0] << "." << std::endl;
+    }
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include "../base.h"
+#include "../arg.h"
+
+namespace cli {
+    extern const char* command_profile_string;
+    void command_profile_func(ArgChain& args);
+}
@@ -0,0 +1,53 @@
+#include "query.h"
+#include <iostream>
+#include "../../core/project.h"
+
+namespace cli {
+    const char* command_query_string =
+R"(Usage: repaintbrush query [-f] <sql>
+
+Run a single SQL statement against the project database and print its rows,
+with one line per row and columns separated by tabs. NULL is printed as an
+empty column. Statements that would change the database are refused.
+
+Options:
+    -f, --force    Force opening of the project
+
+Queries may use two functions of their own:
+    rb_scan(folder)
+                   A table of every file in folder and its subfolders, with
+                   the columns name and path. Folders are scanned as the
+                   query reads them, without storing the files anywhere.
+    rb_filtered(kind, base, path)
+                   1 if the project's filters of the given kind, input or
+                   output, ignore path inside of base, and 0 otherwise.
+
+For example, to list the files of an input folder that would be imported:
+    repaintbrush query "SELECT path FROM rb_scan('/dump')
+        WHERE rb_filtered('input', '/dump', path) = 0")";
+
+    void command_query_func(ArgChain& args)
+    {
+        ArgBlock block = args.parse(1, false, {
+            {"force", false, 'f'}
+        });
+        block.assert_all_args();
+        args.assert_finished();
+
+        bool force = block.has_option("force");
+        auto project = core::get_project(force, false);
+        if (!project) return;
+
+        project->query(block[0], [](database::Statement& stmt) {
+            int columns = sqlite3_column_count(stmt.stmt_ptr());
+            for (int key = 1; key <= columns; ++key) {
+                if (key > 1) {
+                    std::cout << '\t';
+                }
+                // NULL columns read as empty strings
+                std::cout << stmt.column_value<boost::string_view>(key);
+            }
+            std::cout << '\n';
+        });
+    }
+}
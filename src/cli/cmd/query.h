@@ -0,0 +1,8 @@
+#pragma once
+#include "../base.h"
+#include "../arg.h"
+
+namespace cli {
+    extern const char* command_query_string;
+    void command_query_func(ArgChain& args);
+}
@@ -0,0 +1,135 @@
+#include "watch.h"
+#include <atomic>
+#include <csignal>
+#include <iostream>
+#include "../../core/project.h"
+#include "../../core/watch.h"
+
+namespace cli {
+    const char* command_watch_string =
+R"(Usage: repaintbrush watch [-i input] [-m mode] [-j n] [-f] <target>
+
+Import input images into the target folder, then keep importing new images
+as soon as they appear in the input folders, until interrupted.
+
+Options:
+    -f, --force            Force opening of the project
+    -i, --input <input>    Only watch the given input folder
+    --delay <ms>           Wait until no new files have appeared for this
+                           many milliseconds before importing (default 200)
+    -m, --mode <mode>      How files are placed into the target folder
+    -j, --jobs <n>         Number of files to transfer at once
+    --queue <n>            Number of files queued up for transfer
+    --engine <engine>      Transfer with a pool of threads (default), or
+                           with io_uring
+    --batch <n>            Number of transferred files to commit at once
+    --duplicates <how>     What to do with files whose contents are already
+                           registered under another name
+
+Images are imported once they have been completely written. See
+`repaintbrush help import` for a list of transfer modes and ways to handle
+duplicates.)";
+
+    std::atomic<bool> watch_stopped(false);
+
+    void watch_stop_handler(int)
+    {
+        watch_stopped = true;
+    }
+
+    void print_watch_result(const core::Project::Result& result)
+    {
+        if (result.files > 0) {
+            std::cout << "Imported " << result.files << " files";
+            if (result.duplicates > 0) {
+                std::cout << ", " << result.duplicates << " of them duplicates";
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    void command_watch_func(ArgChain& args)
+    {
+        std::vector<ArgParse> argdefs = {
+            {"force", false, 'f'},
+            {"input", true, 'i'},
+            {"delay", true, {}},
+            {"batch", true, {}},
+            {"duplicates", true, {}}
+        };
+        argdefs.insert(argdefs.end(), transfer_arg_definitions.begin(),
+            transfer_arg_definitions.end());
+        ArgBlock block = args.parse(1, false, argdefs);
+        args.assert_finished();
+        core::TransferOptions options;
+        if (!get_transfer_options(block, options)) return;
+        if (!get_duplicates_option(block, options)) return;
+        size_t delay = 200;
+        if (!get_count_option(block, "delay", delay)) return;
+        // get import folder
+        boost::optional<fs::path> import_folder;
+        if (block.has_option("input")) {
+            import_folder = block.get_option("input");
+        }
+        // get export folder
+        fs::path export_folder = "";
+        if (block.size() > 0) {
+            export_folder = block[0];
+        }
+        // get project.
+        bool force = block.has_option("force");
+        auto project = core::get_project(force);
+        if (!project) return;
+
+        std::vector<fs::path> roots;
+        for (const fs::path& folder : project->list_input_folders()) {
+            if (!import_folder || fs::equivalent(*import_folder, folder)) {
+                roots.push_back(folder);
+            }
+        }
+        if (roots.empty()) {
+            if (import_folder) {
+                std::cout << "No such import folder " << *import_folder
+                          << std::endl;
+            } else {
+                std::cout << "No input folders to watch." << std::endl;
+            }
+            return;
+        }
+
+        // Stop cleanly on Ctrl-C, so that the project lock is released.
+        struct sigaction action = {};
+        action.sa_handler = watch_stop_handler;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+
+        // Start watching before the first import, so that no files are
+        // missed in between.
+        core::Watcher watcher(roots, std::chrono::milliseconds(delay));
+        auto result = project->import(export_folder, import_folder, options);
+        print_watch_result(result);
+        std::cout << "Watching " << roots.size()
+                  << " input folders. Press Ctrl-C to stop." << std::endl;
+
+        core::Watcher::Batch batch;
+        while (watcher.wait(batch, watch_stopped)) {
+            try {
+                if (batch.overflow) {
+                    // Some files were missed, so look at everything again.
+                    result = project->import(export_folder, import_folder,
+                        options);
+                } else {
+                    result = project->import_files(export_folder, roots,
+                        std::move(batch.files), options);
+                }
+                print_watch_result(result);
+            } catch (std::exception& e) {
+                // Keep watching, the files will be picked up by the next
+                // import.
+                std::cout << e.what() << std::endl;
+            }
+        }
+        std::cout << "Stopped watching." << std::endl;
+    }
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include "../base.h"
+#include "../arg.h"
+
+namespace cli {
+    extern const char* command_watch_string;
+    void command_watch_func(ArgChain& args);
+}
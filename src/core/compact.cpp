@@ -0,0 +1,139 @@
+#include "compact.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <boost/filesystem/fstream.hpp>
+
+namespace core {
+    // Size of the buffers used to compare files
+    const size_t COMPACT_BUFFER_SIZE = 64 * 1024;
+    const std::string COMPACT_TEMP_SUFFIX = ".rbrush-compact";
+
+    namespace {
+        /// Returns true if both files have exactly the same contents.
+        bool is_same_contents(const fs::path& a, const fs::path& b)
+        {
+            fs::ifstream stream_a(a, std::ios::binary);
+            fs::ifstream stream_b(b, std::ios::binary);
+            if (!stream_a || !stream_b) {
+                return false;
+            }
+            std::unique_ptr<char[]> buffer_a(new char[COMPACT_BUFFER_SIZE]);
+            std::unique_ptr<char[]> buffer_b(new char[COMPACT_BUFFER_SIZE]);
+            while (stream_a && stream_b) {
+                stream_a.read(buffer_a.get(), COMPACT_BUFFER_SIZE);
+                stream_b.read(buffer_b.get(), COMPACT_BUFFER_SIZE);
+                if (stream_a.gcount() != stream_b.gcount()
+                || std::memcmp(buffer_a.get(), buffer_b.get(),
+                    stream_a.gcount()) != 0) {
+                    return false;
+                }
+            }
+            return !stream_a.bad() && !stream_b.bad()
+                && stream_a.eof() && stream_b.eof();
+        }
+    }
+
+    std::vector<FileGroup> find_identical_files(
+        const std::vector<fs::path>& files, unsigned threads)
+    {
+        std::vector<FileStat> stats;
+        stats.reserve(files.size());
+        std::map<uint64_t, std::vector<size_t>> by_size;
+        for (size_t i = 0; i < files.size(); ++i) {
+            stats.push_back(get_file_stat(files[i]));
+            by_size[stats.back().size].push_back(i);
+        }
+        // Only files that share their size with another file can be
+        // identical to anything.
+        std::vector<size_t> candidates;
+        for (const auto& pair : by_size) {
+            if (pair.second.size() > 1) {
+                candidates.insert(candidates.end(), pair.second.begin(),
+                    pair.second.end());
+            }
+        }
+        std::vector<fs::path> candidate_paths;
+        candidate_paths.reserve(candidates.size());
+        for (size_t index : candidates) {
+            candidate_paths.push_back(files[index]);
+        }
+        auto candidate_hashes = hash_files(candidate_paths, threads);
+        std::vector<ContentHash> hashes(files.size());
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            hashes[candidates[i]] = candidate_hashes[i];
+        }
+        // Group by hash, with files in path order
+        std::map<std::pair<uint64_t, uint64_t>, std::vector<size_t>> by_hash;
+        for (size_t index : candidates) {
+            by_hash[{hashes[index].size, hashes[index].hash}].push_back(index);
+        }
+        std::vector<FileGroup> ret;
+        for (auto& pair : by_hash) {
+            auto& members = pair.second;
+            if (members.size() < 2) {
+                continue;
+            }
+            std::sort(members.begin(), members.end(), [&](size_t a, size_t b) {
+                return files[a] < files[b];
+            });
+            // A different file with the same hash starts a group of its
+            // own, which is practically never needed.
+            std::vector<std::vector<size_t>> groups;
+            for (size_t index : members) {
+                bool placed = false;
+                for (auto& group : groups) {
+                    size_t first = group.front();
+                    if (stats[first].is_same_file(stats[index])
+                    || is_same_contents(files[first], files[index])) {
+                        group.push_back(index);
+                        placed = true;
+                        break;
+                    }
+                }
+                if (!placed) {
+                    groups.push_back({index});
+                }
+            }
+            for (const auto& group : groups) {
+                if (group.size() < 2) {
+                    continue;
+                }
+                FileGroup result;
+                result.hash = hashes[group.front()];
+                for (size_t index : group) {
+                    result.paths.push_back(files[index]);
+                    result.stats.push_back(stats[index]);
+                }
+                ret.push_back(std::move(result));
+            }
+        }
+        std::sort(ret.begin(), ret.end(),
+            [](const FileGroup& a, const FileGroup& b) {
+                return a.paths.front() < b.paths.front();
+            });
+        return ret;
+    }
+
+    bool share_file_data(const fs::path& source, const fs::path& target,
+        transfer_t mode)
+    {
+        fs::path temp = target.parent_path()
+            / ("." + target.filename().string() + COMPACT_TEMP_SUFFIX);
+        transfer_t used;
+        try {
+            used = transfer_file(source, temp, mode, true);
+        } catch (...) {
+            fs::remove(temp);
+            throw;
+        }
+        if (used != TRANSFER_HARDLINK && used != TRANSFER_REFLINK) {
+            // A plain copy would not save anything
+            fs::remove(temp);
+            return false;
+        }
+        fs::rename(temp, target);
+        return true;
+    }
+}
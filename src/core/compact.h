@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "hash.h"
+#include "transfer.h"
+#include "util.h"
+namespace fs = boost::filesystem;
+
+namespace core {
+    /// Suffix of the temporary files made while files are compacted.
+    extern const std::string COMPACT_TEMP_SUFFIX;
+
+    /// A set of files with identical contents.
+    struct FileGroup {
+        ContentHash hash;
+        /// Paths of every file, sorted. The first one is kept as it is,
+        /// and the others are made to share its data.
+        std::vector<fs::path> paths;
+        /// The stat of each path, taken before the files were hashed.
+        std::vector<FileStat> stats;
+    };
+
+    /// Find every group of files that have identical contents.
+    /// Files are first grouped by size, so only files that share their
+    /// size with another file are read. Those are hashed in parallel by a
+    /// pool of threads, and files with equal hashes are compared byte by
+    /// byte before they are grouped. A thread count of 0 uses one thread
+    /// per hardware thread.
+    std::vector<FileGroup> find_identical_files(
+        const std::vector<fs::path>& files, unsigned threads = 0);
+
+    /// Make target share the data of source, which must have identical
+    /// contents. mode must be TRANSFER_REFLINK or TRANSFER_HARDLINK; the
+    /// link is made next to target and then renamed over it, so target is
+    /// never left half written. Hard links fall back to reflinks.
+    /// Returns false, and leaves target alone, if the file system supports
+    /// neither.
+    bool share_file_data(const fs::path& source, const fs::path& target,
+        transfer_t mode);
+}
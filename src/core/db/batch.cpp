@@ -0,0 +1,97 @@
+#include "batch.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace database {
+    BatchWriter::BatchWriter(Database& db, const std::string& head,
+        const std::string& row, const std::string& tail, size_t max_rows)
+    : m_db(db), m_head(head), m_row(row), m_tail(tail)
+    {
+        m_columns = std::count(row.begin(), row.end(), '?');
+        if (m_columns == 0) {
+            throw std::invalid_argument("Batch rows must have columns");
+        }
+        int limit = sqlite3_limit(db.get_ptr(),
+            SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+        m_max_rows = std::max<size_t>(1,
+            std::min<size_t>(max_rows, limit / m_columns));
+    }
+
+    void BatchWriter::push(int32_t value)
+    {
+        this->push(static_cast<int64_t>(value));
+    }
+
+    void BatchWriter::push(int64_t value)
+    {
+        m_values.push_back(Value {SQLITE_INTEGER, value, 0, {}});
+    }
+
+    void BatchWriter::push(double value)
+    {
+        m_values.push_back(Value {SQLITE_FLOAT, 0, value, {}});
+    }
+
+    void BatchWriter::push(const std::string& value)
+    {
+        m_values.push_back(Value {SQLITE_TEXT, 0, 0, value});
+    }
+
+    void BatchWriter::push(const char* value)
+    {
+        this->push(std::string(value));
+    }
+
+    void BatchWriter::push(std::nullptr_t)
+    {
+        m_values.push_back(Value {SQLITE_NULL, 0, 0, {}});
+    }
+
+    void BatchWriter::write(size_t rows)
+    {
+        std::string sql = m_head;
+        sql.reserve(m_head.size() + rows * (m_row.size() + 2)
+            + m_tail.size());
+        for (size_t i = 0; i < rows; ++i) {
+            if (i > 0) {
+                sql += ", ";
+            }
+            sql += m_row;
+        }
+        sql += m_tail;
+        auto stmt = m_db.prepare(sql);
+        size_t count = rows * m_columns;
+        for (size_t i = 0; i < count; ++i) {
+            const Value& value = m_values[i];
+            int key = i + 1;
+            switch (value.type) {
+            case SQLITE_INTEGER:
+                stmt.bind(key, value.integer);
+                break;
+            case SQLITE_FLOAT:
+                stmt.bind(key, value.real);
+                break;
+            case SQLITE_TEXT:
+                stmt.bind(key, value.text);
+                break;
+            default:
+                stmt.bind_null(key);
+                break;
+            }
+        }
+        stmt.finish();
+        m_values.erase(m_values.begin(), m_values.begin() + count);
+    }
+
+    void BatchWriter::flush()
+    {
+        while (!m_values.empty()) {
+            this->write(std::min(m_max_rows, this->pending()));
+        }
+    }
+
+    size_t BatchWriter::pending() const
+    {
+        return m_values.size() / m_columns;
+    }
+}
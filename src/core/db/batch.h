@@ -0,0 +1,95 @@
+#pragma once
+#include <sqlite3.h>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/optional.hpp>
+#include "database.h"
+
+namespace database {
+    /// Writes many rows with as few statements as possible.
+    /// Rows are collected, and then written by statements that each hold
+    /// many rows, such as a multi-row INSERT ... VALUES (?), (?), ... or a
+    /// DELETE ... WHERE name IN (?, ?, ...). A statement is made of head,
+    /// followed by one copy of row for every row separated by commas,
+    /// followed by tail. Each ? in row is a column.
+    /// Statements are split so that they never have more variables than
+    /// SQLite allows. Since the statements are cached by the Database, each
+    /// statement size is only prepared once.
+    class BatchWriter {
+        /// A single value of a row.
+        struct Value {
+            int type;
+            int64_t integer;
+            double real;
+            std::string text;
+        };
+        Database& m_db;
+        std::string m_head;
+        std::string m_row;
+        std::string m_tail;
+        int m_columns;
+        size_t m_max_rows;
+        std::vector<Value> m_values;
+        /// Write the first rows rows.
+        void write(size_t rows);
+        void push(int32_t value);
+        void push(int64_t value);
+        void push(double value);
+        void push(const std::string& value);
+        void push(const char* value);
+        void push(std::nullptr_t);
+        template<typename V>
+        void push(const boost::optional<V>& value)
+        {
+            if (value) {
+                this->push(*value);
+            } else {
+                this->push(nullptr);
+            }
+        }
+        void push_all() {}
+        template<typename V, typename... Vs>
+        void push_all(const V& value, const Vs&... values)
+        {
+            this->push(value);
+            this->push_all(values...);
+        }
+    public:
+        /// Most rows that are written by a single statement.
+        static const size_t default_max_rows = 256;
+
+        /// Create a writer for statements made of head, row and tail.
+        BatchWriter(Database& db, const std::string& head,
+            const std::string& row, const std::string& tail = "",
+            size_t max_rows = default_max_rows);
+
+        /// Add a row. Valid data types are integers, doubles, strings and
+        /// nullptr, and boost::optional of any of them, where none is NULL.
+        /// Rows are written as soon as enough of them have been added to
+        /// fill a statement, so this may throw the same exceptions as
+        /// Statement::step. Throws an exception if the number of values
+        /// does not match the number of columns.
+        template<typename... Vs>
+        void add(const Vs&... values)
+        {
+            if (sizeof...(values) != static_cast<size_t>(m_columns)) {
+                throw std::invalid_argument("Wrong number of values in row");
+            }
+            this->push_all(values...);
+            if (m_values.size() >= m_max_rows * m_columns) {
+                this->write(m_max_rows);
+            }
+        }
+
+        /// Write all rows that have not been written yet.
+        /// This must be called once all rows are added, rows that are
+        /// still pending when the writer is destroyed are discarded.
+        void flush();
+
+        /// Number of rows that have not been written yet.
+        size_t pending() const;
+    };
+}
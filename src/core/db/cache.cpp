@@ -0,0 +1,71 @@
+#include "cache.h"
+#include <stdexcept>
+
+namespace database {
+    StatementCache::StatementCache(sqlite3* db, size_t capacity)
+    : m_db(db), m_capacity(capacity)
+    {
+    }
+
+    StatementCache::~StatementCache()
+    {
+        this->clear();
+    }
+
+    void StatementCache::trim(size_t capacity)
+    {
+        while (m_entries.size() > capacity) {
+            auto& entry = m_entries.back();
+            m_index.erase(entry.first);
+            sqlite3_finalize(entry.second);
+            m_entries.pop_back();
+        }
+    }
+
+    Statement StatementCache::acquire(const std::string& sql)
+    {
+        auto found = m_index.find(sql);
+        if (found != m_index.end()) {
+            sqlite3_stmt* stmt = found->second->second;
+            m_entries.erase(found->second);
+            m_index.erase(found);
+            return Statement(stmt, this->shared_from_this(), sql);
+        }
+        sqlite3_stmt* stmt;
+        int ok = sqlite3_prepare_v2(m_db, sql.c_str(), sql.size(), &stmt,
+            nullptr);
+        if (ok != SQLITE_OK) {
+            auto err = std::runtime_error(sqlite3_errmsg(m_db));
+            sqlite3_finalize(stmt);
+            throw err;
+        }
+        return Statement(stmt, this->shared_from_this(), sql);
+    }
+
+    void StatementCache::release(const std::string& sql, sqlite3_stmt* stmt)
+    {
+        // Reset right away, so that the statement does not keep a read
+        // transaction open while it sits in the cache.
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        if (m_capacity == 0 || m_index.count(sql)) {
+            // Another lease for the same SQL already came back
+            sqlite3_finalize(stmt);
+            return;
+        }
+        m_entries.emplace_front(sql, stmt);
+        m_index[sql] = m_entries.begin();
+        this->trim(m_capacity);
+    }
+
+    void StatementCache::set_capacity(size_t capacity)
+    {
+        m_capacity = capacity;
+        this->trim(m_capacity);
+    }
+
+    void StatementCache::clear()
+    {
+        this->trim(0);
+    }
+}
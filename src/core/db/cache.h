@@ -0,0 +1,50 @@
+#pragma once
+#include <sqlite3.h>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include "statement.h"
+
+namespace database {
+    /// Keeps prepared statements around after they are used, so that
+    /// statements which are run over and over again are only parsed and
+    /// planned once.
+    /// Statements are keyed by their SQL text. Each Statement handed out by
+    /// the cache is an exclusive lease: while it is alive, the same SQL text
+    /// is prepared again for anyone else who asks for it. Once a lease is
+    /// destroyed, its statement is reset and returned to the cache, and the
+    /// least recently used statements are finalized when the cache is full.
+    class StatementCache
+    : public std::enable_shared_from_this<StatementCache> {
+        using Entry = std::pair<std::string, sqlite3_stmt*>;
+        sqlite3* m_db;
+        size_t m_capacity;
+        /// Idle statements, most recently used first.
+        std::list<Entry> m_entries;
+        std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+        /// Finalize least recently used statements until at most capacity
+        /// are left.
+        void trim(size_t capacity);
+    public:
+        /// Create a cache for db that holds up to capacity statements.
+        StatementCache(sqlite3* db, size_t capacity);
+        ~StatementCache();
+        StatementCache(const StatementCache&) = delete;
+        StatementCache& operator=(const StatementCache&) = delete;
+
+        /// Lease a statement for sql. The statement is reset and has no
+        /// values bound to it.
+        Statement acquire(const std::string& sql);
+
+        /// Give a leased statement back to this cache.
+        void release(const std::string& sql, sqlite3_stmt* stmt);
+
+        /// Change the number of statements that are kept.
+        void set_capacity(size_t capacity);
+
+        /// Finalize all idle statements.
+        void clear();
+    };
+}
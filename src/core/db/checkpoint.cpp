@@ -0,0 +1,35 @@
+#include "checkpoint.h"
+
+namespace database {
+    Checkpointer::Checkpointer(const fs::path& path,
+        std::chrono::milliseconds interval)
+    : m_database(path, SQLITE_OPEN_READWRITE)
+    , m_interval(interval)
+    , m_stop(false)
+    {
+        m_thread = std::thread(&Checkpointer::run, this);
+    }
+
+    Checkpointer::~Checkpointer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cond.notify_all();
+        m_thread.join();
+    }
+
+    void Checkpointer::run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_cond.wait_for(lock, m_interval, [this] { return m_stop; })) {
+            lock.unlock();
+            // A busy database just means that this checkpoint is skipped,
+            // the next one will catch up.
+            sqlite3_wal_checkpoint_v2(m_database.get_ptr(), nullptr,
+                SQLITE_CHECKPOINT_PASSIVE, nullptr, nullptr);
+            lock.lock();
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <boost/filesystem.hpp>
+#include "database.h"
+namespace fs = boost::filesystem;
+
+namespace database {
+    /// Checkpoints a WAL mode database from a background thread.
+    /// The checkpointer has its own connection to the database, so that
+    /// commits on the main connection only need to append to the WAL, and
+    /// do not have to wait for pages to be copied back and synced.
+    /// Checkpoints are passive, so they never block the main connection.
+    class Checkpointer {
+        Database m_database;
+        std::chrono::milliseconds m_interval;
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        bool m_stop;
+        std::thread m_thread;
+        void run();
+    public:
+        /// Start checkpointing the database at path every interval.
+        Checkpointer(const fs::path& path, std::chrono::milliseconds interval);
+        /// Stop checkpointing, waiting for a running checkpoint to finish.
+        ~Checkpointer();
+        Checkpointer(const Checkpointer&) = delete;
+        Checkpointer& operator=(const Checkpointer&) = delete;
+    };
+}
@@ -45,11 +45,23 @@ namespace database {
             throw err;
         }
         this->m_database.reset(db);
+        this->m_cache = std::make_shared<StatementCache>(db,
+            default_cache_capacity);
     }
 
     Statement Database::prepare(const std::string& statement)
     {
-        return Statement(this->m_database.get(), statement);
+        return this->m_cache->acquire(statement);
+    }
+
+    void Database::set_cache_capacity(size_t capacity)
+    {
+        this->m_cache->set_capacity(capacity);
+    }
+
+    void Database::clear_cache()
+    {
+        this->m_cache->clear();
     }
 
     sqlite3* Database::get_ptr()
@@ -5,6 +5,7 @@
 #include <memory>
 #include <boost/filesystem.hpp>
 #include "statement.h"
+#include "cache.h"
 namespace fs = boost::filesystem;
 
 namespace database {
@@ -21,7 +22,13 @@ namespace database {
 
     class Database {
         std::unique_ptr<sqlite3, decltype(&sqlite3_close_v2)> m_database;
+        // Declared after m_database, so that cached statements are finalized
+        // before the connection is closed.
+        std::shared_ptr<StatementCache> m_cache;
     public:
+        /// Number of prepared statements that are kept for reuse by default.
+        static const size_t default_cache_capacity = 64;
+
         // May move a database
         Database(Database&& other) = default;
         Database& operator=(Database&& other) = default;
@@ -33,8 +40,18 @@ namespace database {
         Database(const fs::path& path, int flags);
 
         /// Prepare an SQL statement.
+        /// Statements are cached by their SQL text, so preparing the same
+        /// statement again is cheap once the previous one is destroyed. The
+        /// returned statement is always reset, with no values bound.
         Statement prepare(const std::string& statement);
 
+        /// Change how many prepared statements are kept for reuse.
+        /// A capacity of 0 disables caching.
+        void set_cache_capacity(size_t capacity);
+
+        /// Finalize all cached statements that are not in use.
+        void clear_cache();
+
         /// Get a pointer to this Database's underlying database.
         sqlite3* get_ptr();
 
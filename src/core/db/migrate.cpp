@@ -0,0 +1,53 @@
+#include "migrate.h"
+#include <sstream>
+#include <stdexcept>
+
+namespace database {
+    int get_schema_version(Database& db)
+    {
+        auto stmt = db.prepare("PRAGMA user_version");
+        if (stmt.step() == SQLITE_ROW) {
+            return stmt.column_value<int>(1);
+        }
+        return 0;
+    }
+
+    int migrate(Database& db, const std::vector<Migration>& migrations)
+    {
+        int current = get_schema_version(db);
+        int latest = migrations.empty() ? 0 : migrations.back().version;
+        if (current > latest) {
+            std::stringstream s;
+            s << "Database schema version " << current << " is newer than "
+              << "the newest supported version " << latest << ".\n"
+              << "Please update Repaintbrush to open this project.";
+            throw std::runtime_error(s.str());
+        }
+        int applied = 0;
+        for (const auto& migration : migrations) {
+            if (migration.version <= current) {
+                continue;
+            }
+            // BEGIN IMMEDIATE takes the write lock up front so that two
+            // processes can not both decide to apply the same migration.
+            db.execute("BEGIN IMMEDIATE TRANSACTION");
+            try {
+                migration.apply(db);
+                // PRAGMA does not accept bound parameters
+                db.execute("PRAGMA user_version = "
+                    + std::to_string(migration.version));
+                db.execute("COMMIT TRANSACTION");
+            } catch (...) {
+                try {
+                    db.execute("ROLLBACK TRANSACTION");
+                } catch (...) {
+                    // The original error is more important
+                }
+                throw;
+            }
+            current = migration.version;
+            ++ applied;
+        }
+        return applied;
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include "database.h"
+
+namespace database {
+    /// A single step in a database's schema history.
+    struct Migration {
+        /// The schema version that this migration upgrades the database to.
+        int version;
+        /// Function that performs the upgrade.
+        std::function<void(Database&)> apply;
+    };
+
+    /// Get the schema version of a database.
+    /// New and legacy databases both report a version of 0.
+    int get_schema_version(Database& db);
+
+    /// Upgrade a database in place by applying every migration whose version
+    /// is greater than the database's current schema version, in order.
+    /// Each migration runs inside of its own transaction, so a failed
+    /// migration leaves the database at the last successfully applied version.
+    /// Throws an exception if the database is newer than the newest migration.
+    /// Returns the number of migrations that were applied.
+    int migrate(Database& db, const std::vector<Migration>& migrations);
+}
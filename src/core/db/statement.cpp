@@ -1,8 +1,25 @@
 #include "statement.h"
+#include "cache.h"
 
 namespace database {
+    void Statement::Release::operator()(sqlite3_stmt* stmt) const
+    {
+        if (auto cache = m_cache.lock()) {
+            cache->release(m_sql, stmt);
+        } else {
+            sqlite3_finalize(stmt);
+        }
+    }
+
+    Statement::Statement(sqlite3_stmt* stmt,
+        const std::shared_ptr<StatementCache>& cache, const std::string& sql)
+    : m_statement(stmt, Release {cache, sql})
+    , m_status(SQLITE_OK)
+    {
+    }
+
     Statement::Statement(sqlite3* db, const std::string& statement)
-    : m_statement(nullptr, &sqlite3_finalize)
+    : m_statement(nullptr)
     , m_status(SQLITE_OK)
     {
         sqlite3_stmt* stmt;
@@ -59,6 +76,25 @@ namespace database {
         return this->bind_null(ikey);
     }
 
+    int Statement::column_key(const std::string& name)
+    {
+        if (!this->m_columns) {
+            this->m_columns.reset(new std::unordered_map<std::string, int>());
+            int count = sqlite3_column_count(this->stmt_ptr());
+            for (int i = 0; i < count; i ++) {
+                this->m_columns->emplace(
+                    sqlite3_column_name(this->stmt_ptr(), i), i + 1);
+            }
+        }
+        auto found = this->m_columns->find(name);
+        if (found == this->m_columns->end()) {
+            std::stringstream s;
+            s << "No such key '" << name << "' exists in row.";
+            throw std::runtime_error(s.str());
+        }
+        return found->second;
+    }
+
     sqlite3_stmt* Statement::stmt_ptr()
     {
         return this->m_statement.get();
@@ -110,8 +146,21 @@ namespace database {
         // that would end up being more confusing because SQL statements can
         // also use the ?NNN format, which would break things a little.
         key --;
+        return this->column_value<boost::string_view>(key + 1).to_string();
+    }
+
+    template<>
+    boost::string_view Statement::column_value(int key)
+    {
+        key --;
+        // NULL columns read as an empty string. Text must be read before its
+        // size, since reading it may convert the value.
         const unsigned char* c = sqlite3_column_text(this->stmt_ptr(), key);
-        return std::string(reinterpret_cast<const char*>(c));
+        if (!c) {
+            return boost::string_view();
+        }
+        int size = sqlite3_column_bytes(this->stmt_ptr(), key);
+        return boost::string_view(reinterpret_cast<const char*>(c), size);
     }
 
     // Bind templates
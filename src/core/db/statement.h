@@ -3,11 +3,33 @@
 #include <string>
 #include <sstream>
 #include <memory>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <boost/utility/string_view.hpp>
 
 namespace database {
+    class StatementCache;
+    template<typename... V>
+    class RowRange;
+
     class Statement {
-        std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> m_statement;
+        /// Gives a statement back to the cache it came from, or finalizes it
+        /// if it did not come from a cache, or if that cache is gone.
+        struct Release {
+            std::weak_ptr<StatementCache> m_cache;
+            std::string m_sql;
+            void operator()(sqlite3_stmt* stmt) const;
+        };
+        std::unique_ptr<sqlite3_stmt, Release> m_statement;
         int m_status;
+        /// Maps column names to keys, filled in on first use.
+        std::unique_ptr<std::unordered_map<std::string, int>> m_columns;
+        /// Lease a statement from cache.
+        Statement(sqlite3_stmt* stmt,
+            const std::shared_ptr<StatementCache>& cache,
+            const std::string& sql);
+        friend class StatementCache;
     public:
         /// Create a new statement.
         /// It is recommended to use Database::prepare instead.
@@ -40,19 +62,26 @@ namespace database {
         template<class V>
         V column_value(int key);
 
+        /// Get the key of the column with the given name.
+        /// Throws an exception if there is no such column.
+        int column_key(const std::string& name);
+
         /// Get the type of a column corresponding to key.
         /// The key should match a table parameter.
         template<typename V>
         V column_value(const std::string& key)
         {
-            for (int i = 0; i < sqlite3_column_count(this->stmt_ptr()); i ++){
-                if (key == sqlite3_column_name(this->stmt_ptr(), i)) {
-                    return this->column_value<V>(i+1);
-                }
-            }
-            std::stringstream s;
-            s << "No such key '" << key << "'" << "exists in row.";
-            throw std::runtime_error(s.str());
+            return this->column_value<V>(this->column_key(key));
+        }
+
+        /// Iterate over the remaining rows of this statement.
+        /// Each row is a tuple of its first sizeof...(V) columns, read with
+        /// column_value. Rows may hold boost::string_view columns, which are
+        /// only valid until the next row is read.
+        template<typename... V>
+        RowRange<V...> rows()
+        {
+            return RowRange<V...>(this);
         }
 
         /// Bind a null value to the given key.
@@ -96,6 +125,69 @@ namespace database {
     double Statement::column_value(int key);
     template<>
     std::string Statement::column_value(int key);
+    /// Zero-copy text access. The view is only valid until the statement is
+    /// stepped, reset or destroyed.
+    template<>
+    boost::string_view Statement::column_value(int key);
+
+    /// Input range over the rows of a statement. See Statement::rows.
+    template<typename... V>
+    class RowRange {
+        Statement* m_statement;
+    public:
+        class iterator {
+            Statement* m_statement;
+            template<size_t... I>
+            std::tuple<V...> read(std::index_sequence<I...>) const
+            {
+                return std::tuple<V...>(
+                    m_statement->column_value<V>(I + 1)...);
+            }
+        public:
+            iterator(Statement* statement)
+            : m_statement(statement)
+            {
+                this->advance();
+            }
+
+            /// Step the statement, or become the end iterator once done.
+            void advance()
+            {
+                if (m_statement && m_statement->step() != SQLITE_ROW) {
+                    m_statement = nullptr;
+                }
+            }
+
+            std::tuple<V...> operator*() const
+            {
+                return this->read(std::index_sequence_for<V...>());
+            }
+
+            iterator& operator++()
+            {
+                this->advance();
+                return *this;
+            }
+
+            bool operator!=(const iterator& other) const
+            {
+                return m_statement != other.m_statement;
+            }
+        };
+
+        RowRange(Statement* statement)
+        : m_statement(statement) {}
+
+        iterator begin() const
+        {
+            return iterator(m_statement);
+        }
+
+        iterator end() const
+        {
+            return iterator(nullptr);
+        }
+    };
 
     template<>
     bool Statement::bind<int32_t>(int key, const int32_t& value);
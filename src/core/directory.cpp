@@ -0,0 +1,199 @@
+#include "directory.h"
+#include <cerrno>
+#include <cstring>
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace core {
+#ifdef __linux__
+    // Size of the buffer handed to getdents64. Each entry takes roughly
+    // 24 bytes plus its name, so this fits a few thousand entries per call.
+    const size_t DIRECTORY_BUFFER_SIZE = 128 * 1024;
+
+    // glibc only exposes getdents64 as of version 2.30
+    struct linux_dirent64 {
+        ino64_t d_ino;
+        off64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[256];
+    };
+
+    fs::filesystem_error make_error(const char* what, const fs::path& path)
+    {
+        return fs::filesystem_error(what, path,
+            boost::system::error_code(errno, boost::system::system_category()));
+    }
+
+    entry_t get_mode_type(mode_t mode)
+    {
+        if (S_ISREG(mode)) {
+            return ENTRY_FILE;
+        } else if (S_ISDIR(mode)) {
+            return ENTRY_DIRECTORY;
+        }
+        return ENTRY_OTHER;
+    }
+
+    DirectoryReader::DirectoryReader(const fs::path& path)
+    : m_fd(-1), m_path(path), m_buffer(new char[DIRECTORY_BUFFER_SIZE])
+    , m_size(0), m_pos(0)
+    {
+        this->m_fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (this->m_fd < 0) {
+            throw make_error("DirectoryReader", path);
+        }
+    }
+
+    DirectoryReader::DirectoryReader(const DirectoryReader& parent,
+        const char* name)
+    : m_fd(-1), m_path(parent.m_path / name)
+    , m_buffer(new char[DIRECTORY_BUFFER_SIZE]), m_size(0), m_pos(0)
+    {
+        this->m_fd = openat(parent.m_fd, name,
+            O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (this->m_fd < 0) {
+            throw make_error("DirectoryReader", this->m_path);
+        }
+    }
+
+    DirectoryReader::~DirectoryReader()
+    {
+        if (this->m_fd >= 0) {
+            close(this->m_fd);
+        }
+    }
+
+    bool DirectoryReader::next(Entry& entry)
+    {
+        while (true) {
+            if (!this->m_buffer) {
+                return false;
+            }
+            if (this->m_pos >= this->m_size) {
+                this->m_size = syscall(SYS_getdents64, this->m_fd,
+                    this->m_buffer.get(), DIRECTORY_BUFFER_SIZE);
+                this->m_pos = 0;
+                if (this->m_size < 0) {
+                    throw make_error("getdents64", this->m_path);
+                }
+                if (this->m_size == 0) {
+                    // Readers stay open for as long as their subdirectories
+                    // still need to be opened, so let go of the buffer early.
+                    this->m_buffer.reset();
+                    return false;
+                }
+            }
+            auto dirent = reinterpret_cast<linux_dirent64*>(
+                this->m_buffer.get() + this->m_pos);
+            this->m_pos += dirent->d_reclen;
+            const char* name = dirent->d_name;
+            if (std::strcmp(name, ".") == 0 || std::strcmp(name, "..") == 0) {
+                continue;
+            }
+            entry.name = name;
+            struct stat st;
+            switch (dirent->d_type) {
+            case DT_REG:
+                entry.type = ENTRY_FILE;
+                break;
+            case DT_DIR:
+                entry.type = ENTRY_DIRECTORY;
+                break;
+            case DT_LNK:
+                // Links to files count as files, but links to directories
+                // are not followed.
+                if (fstatat(this->m_fd, name, &st, 0) == 0
+                && S_ISREG(st.st_mode)) {
+                    entry.type = ENTRY_FILE;
+                } else {
+                    entry.type = ENTRY_OTHER;
+                }
+                break;
+            case DT_UNKNOWN:
+                // Some file systems do not fill in d_type at all
+                if (fstatat(this->m_fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                    // The entry was removed while reading
+                    continue;
+                }
+                if (S_ISLNK(st.st_mode)) {
+                    if (fstatat(this->m_fd, name, &st, 0) == 0
+                    && S_ISREG(st.st_mode)) {
+                        entry.type = ENTRY_FILE;
+                    } else {
+                        entry.type = ENTRY_OTHER;
+                    }
+                } else {
+                    entry.type = get_mode_type(st.st_mode);
+                }
+                break;
+            default:
+                entry.type = ENTRY_OTHER;
+                break;
+            }
+            return true;
+        }
+    }
+
+    DirectoryReader::Stat DirectoryReader::stat() const
+    {
+        struct stat st;
+        if (fstat(this->m_fd, &st) != 0) {
+            throw make_error("stat", this->m_path);
+        }
+        return Stat {
+            static_cast<uint64_t>(st.st_ino),
+            static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000
+                + st.st_mtim.tv_nsec
+        };
+    }
+#else
+    DirectoryReader::DirectoryReader(const fs::path& path)
+    : m_fd(-1), m_path(path), m_iter(path) {}
+
+    DirectoryReader::DirectoryReader(const DirectoryReader& parent,
+        const char* name)
+    : m_fd(-1), m_path(parent.m_path / name), m_iter(m_path) {}
+
+    DirectoryReader::~DirectoryReader() {}
+
+    bool DirectoryReader::next(Entry& entry)
+    {
+        if (this->m_iter == fs::directory_iterator()) {
+            return false;
+        }
+        auto status = this->m_iter->status();
+        if (fs::is_symlink(this->m_iter->symlink_status())
+        && fs::is_directory(status)) {
+            entry.type = ENTRY_OTHER;
+        } else if (fs::is_regular_file(status)) {
+            entry.type = ENTRY_FILE;
+        } else if (fs::is_directory(status)) {
+            entry.type = ENTRY_DIRECTORY;
+        } else {
+            entry.type = ENTRY_OTHER;
+        }
+        this->m_name = this->m_iter->path().filename().string();
+        entry.name = this->m_name.c_str();
+        ++ this->m_iter;
+        return true;
+    }
+
+    DirectoryReader::Stat DirectoryReader::stat() const
+    {
+        // There is no portable inode, so only the time is compared
+        return Stat {0, static_cast<int64_t>(
+            fs::last_write_time(this->m_path)) * 1000000000};
+    }
+#endif
+
+    const fs::path& DirectoryReader::get_path() const
+    {
+        return this->m_path;
+    }
+}
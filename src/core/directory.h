@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <boost/filesystem.hpp>
+namespace fs = boost::filesystem;
+
+namespace core {
+    /// The kind of an entry in a directory.
+    enum entry_t {
+        ENTRY_FILE,
+        ENTRY_DIRECTORY,
+        ENTRY_OTHER
+    };
+
+    /// Reads the entries of a single directory.
+    /// On Linux, entries are read in large batches with getdents64, and the
+    /// type of each entry is taken from d_type, so no entry has to be stat'd
+    /// unless the file system does not report types, or the entry is a
+    /// symbolic link. Symbolic links are followed for files but not for
+    /// directories, which matches fs::recursive_directory_iterator.
+    class DirectoryReader {
+        int m_fd;
+        fs::path m_path;
+#ifdef __linux__
+        std::unique_ptr<char[]> m_buffer;
+        long m_size;
+        long m_pos;
+#else
+        fs::directory_iterator m_iter;
+        std::string m_name;
+#endif
+    public:
+        /// A single entry in a directory.
+        /// The name is only valid until the next call to next.
+        struct Entry {
+            const char* name;
+            entry_t type;
+        };
+
+        /// Open a directory by its path.
+        DirectoryReader(const fs::path& path);
+        /// Open a directory inside of an already opened directory. This
+        /// avoids resolving the full path again for every subdirectory.
+        DirectoryReader(const DirectoryReader& parent, const char* name);
+        ~DirectoryReader();
+        // Can NOT copy or move a reader
+        DirectoryReader(const DirectoryReader& other) = delete;
+        DirectoryReader& operator=(const DirectoryReader& other) = delete;
+
+        /// Identity and modification time of a directory.
+        struct Stat {
+            uint64_t inode;
+            /// Modification time, in nanoseconds since the epoch
+            int64_t mtime;
+        };
+
+        /// Get the path of this directory.
+        const fs::path& get_path() const;
+
+        /// Get the inode and modification time of this directory.
+        Stat stat() const;
+
+        /// Read the next entry into entry. The '.' and '..' entries are
+        /// skipped. Returns false once there are no entries left.
+        bool next(Entry& entry);
+    };
+}
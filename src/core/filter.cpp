@@ -1,23 +1,53 @@
 #include "filter.h"
+#include "solid.h"
+#include "texname.h"
 #include "util.h"
+#include <algorithm>
+#include <cctype>
 #include <boost/algorithm/string.hpp>
-#include <regex>
 
 #define FILTER(name, classname, hasarg, description) \
     {name, {classname::deserialize, hasarg, description}}
 
-// ends with _mip and one or more numbers
-const std::regex match_mipmap("^.*_mip[0-9]+$");
-bool filter_mipmaps(const fs::path& path)
-{
-    if (!path.has_stem()) {
+namespace core {
+    /// Get the extension of a file name, the same way fs::path::extension
+    /// does.
+    boost::string_view get_extension(boost::string_view filename)
+    {
+        if (filename == "." || filename == "..") {
+            return {};
+        }
+        size_t pos = filename.rfind('.');
+        if (pos == boost::string_view::npos) {
+            return {};
+        }
+        return filename.substr(pos);
+    }
+
+    bool is_mipmap_name(boost::string_view filename)
+    {
+        return bool(get_mip_level(filename));
+    }
+
+    /// Get the file name of a path as a view into the path.
+    boost::string_view get_filename_view(const fs::path& path)
+    {
+        boost::string_view native = path.native();
+        size_t pos = native.rfind('/');
+        return pos == boost::string_view::npos ? native
+            : native.substr(pos + 1);
+    }
+
+    bool IFilter::prune(const fs::path&, const fs::path&) const
+    {
+        return false;
+    }
+
+    bool IFilter::compile(FilterSet&) const
+    {
         return false;
     }
-    std::string stem = path.stem().string();
-    return std::regex_match(stem, match_mipmap);
-}
 
-namespace core {
     // Filter MipMap
     std::unique_ptr<IFilter> FilterMipMap::deserialize(const std::string& arg)
     {
@@ -29,7 +59,13 @@ namespace core {
 
     bool FilterMipMap::filter(const fs::path& base, const fs::path& path) const
     {
-        return filter_mipmaps(path);
+        return is_mipmap_name(path.filename().string());
+    }
+
+    bool FilterMipMap::compile(FilterSet& set) const
+    {
+        set.add_mipmap();
+        return true;
     }
 
     std::string FilterMipMap::serialize() const
@@ -47,11 +83,17 @@ namespace core {
 
     bool FilterType::filter(const fs::path& base, const fs::path& path) const
     {
-        if (!path.has_extension() && this->m_path == "") {
-            return true;
-        } else {
-            return path.extension() == "." + this->m_path;
+        auto extension = get_extension(path.filename().string());
+        if (extension.empty()) {
+            return this->m_path.empty();
         }
+        return extension.substr(1) == this->m_path;
+    }
+
+    bool FilterType::compile(FilterSet& set) const
+    {
+        set.add_extension("." + this->m_path);
+        return true;
     }
 
     std::string FilterType::serialize() const
@@ -72,11 +114,324 @@ namespace core {
         return core::is_path_within_path(path, base/this->m_path);
     }
 
+    bool FilterPath::prune(const fs::path& base, const fs::path& path) const
+    {
+        return core::is_path_within_path(path, base/this->m_path);
+    }
+
+    bool FilterPath::compile(FilterSet& set) const
+    {
+        // Paths that are not plain relative paths keep the exact semantics
+        // of is_path_within_path.
+        if (this->m_path.empty() || this->m_path.has_root_path()) {
+            return false;
+        }
+        for (const auto& part : this->m_path) {
+            if (part == "." || part == ".." || part.empty()) {
+                return false;
+            }
+        }
+        set.add_path(this->m_path);
+        return true;
+    }
+
     std::string FilterPath::serialize() const
     {
         return this->m_path.string();
     }
 
+    // Filter Glob
+    std::unique_ptr<IFilter> FilterGlob::deserialize(const std::string& arg)
+    {
+        auto ret = std::make_unique<FilterGlob>();
+        ret->m_glob = arg;
+        try {
+            ret->m_pattern.add(glob_to_regex(arg));
+        } catch (const std::invalid_argument&) {
+            return nullptr;
+        }
+        return ret;
+    }
+
+    bool FilterGlob::filter(const fs::path&, const fs::path& path) const
+    {
+        return this->m_pattern.match(get_filename_view(path));
+    }
+
+    bool FilterGlob::compile(FilterSet& set) const
+    {
+        set.add_pattern(glob_to_regex(this->m_glob));
+        return true;
+    }
+
+    std::string FilterGlob::serialize() const
+    {
+        return this->m_glob;
+    }
+
+    // Filter Regex
+    std::unique_ptr<IFilter> FilterRegex::deserialize(const std::string& arg)
+    {
+        auto ret = std::make_unique<FilterRegex>();
+        ret->m_regex = arg;
+        try {
+            ret->m_pattern.add(arg);
+        } catch (const std::invalid_argument&) {
+            return nullptr;
+        }
+        return ret;
+    }
+
+    bool FilterRegex::filter(const fs::path&, const fs::path& path) const
+    {
+        return this->m_pattern.match(get_filename_view(path));
+    }
+
+    bool FilterRegex::compile(FilterSet& set) const
+    {
+        set.add_pattern(this->m_regex);
+        return true;
+    }
+
+    std::string FilterRegex::serialize() const
+    {
+        return this->m_regex;
+    }
+
+    bool is_power_of_two(uint32_t value)
+    {
+        return value != 0 && (value & (value - 1)) == 0;
+    }
+
+    /// Parse a size written as WxH, or just W for a square.
+    bool parse_size(const std::string& arg, uint32_t& width, uint32_t& height)
+    {
+        std::string width_str = arg;
+        std::string height_str = arg;
+        size_t split = arg.find('x');
+        if (split != std::string::npos) {
+            width_str = arg.substr(0, split);
+            height_str = arg.substr(split + 1);
+        }
+        for (const auto& str : {width_str, height_str}) {
+            if (str.empty() || !std::all_of(str.begin(), str.end(),
+                [](unsigned char c) { return std::isdigit(c); })) {
+                return false;
+            }
+        }
+        try {
+            unsigned long parsed_width = std::stoul(width_str);
+            unsigned long parsed_height = std::stoul(height_str);
+            if (parsed_width > UINT32_MAX || parsed_height > UINT32_MAX) {
+                return false;
+            }
+            width = parsed_width;
+            height = parsed_height;
+        } catch (const std::logic_error&) {
+            return false;
+        }
+        return true;
+    }
+
+    // Filter Size
+    std::unique_ptr<IFilter> FilterSize::deserialize(const std::string& arg)
+    {
+        auto ret = std::make_unique<FilterSize>();
+        if (!parse_size(arg, ret->m_width, ret->m_height)) {
+            return nullptr;
+        }
+        return ret;
+    }
+
+    bool FilterSize::filter(const fs::path&, const fs::path& path) const
+    {
+        auto info = read_image_info(path);
+        return info.format != IMAGE_UNKNOWN && info.width <= this->m_width
+            && info.height <= this->m_height;
+    }
+
+    bool FilterSize::compile(FilterSet& set) const
+    {
+        set.add_image_size(this->m_width, this->m_height);
+        return true;
+    }
+
+    std::string FilterSize::serialize() const
+    {
+        return std::to_string(this->m_width) + "x"
+            + std::to_string(this->m_height);
+    }
+
+    // Filter Format
+    std::unique_ptr<IFilter> FilterFormat::deserialize(const std::string& arg)
+    {
+        auto format = get_texture_format_by_name(arg);
+        if (!format) {
+            return nullptr;
+        }
+        auto ret = std::make_unique<FilterFormat>();
+        ret->m_format = *format;
+        return ret;
+    }
+
+    bool FilterFormat::filter(const fs::path&, const fs::path& path)
+        const
+    {
+        auto texture = parse_texture_name(path.filename().string());
+        return texture && texture->format == this->m_format;
+    }
+
+    bool FilterFormat::compile(FilterSet& set) const
+    {
+        set.add_texture_format(this->m_format);
+        return true;
+    }
+
+    std::string FilterFormat::serialize() const
+    {
+        return get_texture_format_name(this->m_format);
+    }
+
+    // Filter Texture Size
+    std::unique_ptr<IFilter> FilterTextureSize::deserialize(
+        const std::string& arg)
+    {
+        auto ret = std::make_unique<FilterTextureSize>();
+        if (!parse_size(arg, ret->m_width, ret->m_height)) {
+            return nullptr;
+        }
+        return ret;
+    }
+
+    bool FilterTextureSize::filter(const fs::path&,
+        const fs::path& path) const
+    {
+        auto texture = parse_texture_name(path.filename().string());
+        return texture && texture->width <= this->m_width
+            && texture->height <= this->m_height;
+    }
+
+    bool FilterTextureSize::compile(FilterSet& set) const
+    {
+        set.add_texture_size(this->m_width, this->m_height);
+        return true;
+    }
+
+    std::string FilterTextureSize::serialize() const
+    {
+        return std::to_string(this->m_width) + "x"
+            + std::to_string(this->m_height);
+    }
+
+    // Filter Non Power Of Two
+    std::unique_ptr<IFilter> FilterNonPowerOfTwo::deserialize(
+        const std::string& arg)
+    {
+        if (arg != "") {
+            return nullptr;
+        }
+        return std::make_unique<FilterNonPowerOfTwo>();
+    }
+
+    bool FilterNonPowerOfTwo::filter(const fs::path&,
+        const fs::path& path) const
+    {
+        auto info = read_image_info(path);
+        return info.format != IMAGE_UNKNOWN
+            && !(is_power_of_two(info.width) && is_power_of_two(info.height));
+    }
+
+    bool FilterNonPowerOfTwo::compile(FilterSet& set) const
+    {
+        set.add_image_npot();
+        return true;
+    }
+
+    std::string FilterNonPowerOfTwo::serialize() const
+    {
+        return "";
+    }
+
+    // Filter Opaque
+    std::unique_ptr<IFilter> FilterOpaque::deserialize(const std::string& arg)
+    {
+        if (arg != "") {
+            return nullptr;
+        }
+        return std::make_unique<FilterOpaque>();
+    }
+
+    bool FilterOpaque::filter(const fs::path&, const fs::path& path) const
+    {
+        auto info = read_image_info(path);
+        return info.format != IMAGE_UNKNOWN && !info.alpha;
+    }
+
+    bool FilterOpaque::compile(FilterSet& set) const
+    {
+        set.add_image_opaque();
+        return true;
+    }
+
+    std::string FilterOpaque::serialize() const
+    {
+        return "";
+    }
+
+    // Filter Paletted
+    std::unique_ptr<IFilter> FilterPaletted::deserialize(
+        const std::string& arg)
+    {
+        if (arg != "") {
+            return nullptr;
+        }
+        return std::make_unique<FilterPaletted>();
+    }
+
+    bool FilterPaletted::filter(const fs::path&,
+        const fs::path& path) const
+    {
+        auto info = read_image_info(path);
+        return info.format != IMAGE_UNKNOWN && info.paletted;
+    }
+
+    bool FilterPaletted::compile(FilterSet& set) const
+    {
+        set.add_image_paletted();
+        return true;
+    }
+
+    std::string FilterPaletted::serialize() const
+    {
+        return "";
+    }
+
+    // Filter Solid
+    std::unique_ptr<IFilter> FilterSolid::deserialize(const std::string& arg)
+    {
+        if (arg != "") {
+            return nullptr;
+        }
+        return std::make_unique<FilterSolid>();
+    }
+
+    bool FilterSolid::filter(const fs::path&, const fs::path& path) const
+    {
+        auto info = read_image_info(path);
+        return read_image_solid(path, info) == SOLID_YES;
+    }
+
+    bool FilterSolid::compile(FilterSet& set) const
+    {
+        set.add_image_solid();
+        return true;
+    }
+
+    std::string FilterSolid::serialize() const
+    {
+        return "";
+    }
+
     // Filter
     Filter::Filter(std::unique_ptr<IFilter> ptr, const std::string& name)
     : m_filter(std::move(ptr)), m_name(name), m_valid_name(true) {}
@@ -91,6 +446,16 @@ namespace core {
         return this->filter(base, path);
     }
 
+    bool Filter::prune(const fs::path& base, const fs::path& path) const
+    {
+        return this->m_filter->prune(base, path);
+    }
+
+    bool Filter::compile(FilterSet& set) const
+    {
+        return this->m_filter->compile(set);
+    }
+
     const std::string& Filter::get_name() const
     {
         return this->m_name;
@@ -116,12 +481,323 @@ namespace core {
         return this->m_valid_name;
     }
 
+    // Filter Set
+    FilterSet::FilterSet()
+    : m_mipmap(false), m_texture_formats(0), m_path_nodes(1)
+    , m_image_npot(false)
+    , m_image_opaque(false), m_image_paletted(false), m_image_solid(false)
+    , m_image_cache(nullptr) {}
+
+    void FilterSet::add(Filter filter)
+    {
+        if (!filter.valid()) {
+            // Unknown filters can not filter anything
+            return;
+        }
+        if (!filter.compile(*this)) {
+            this->m_others.push_back(std::move(filter));
+        }
+    }
+
+    void FilterSet::add_mipmap()
+    {
+        this->m_mipmap = true;
+    }
+
+    void FilterSet::add_texture_format(texture_format_t format)
+    {
+        this->m_texture_formats |= uint32_t(1) << format;
+    }
+
+    void FilterSet::add_texture_size(uint32_t width, uint32_t height)
+    {
+        this->m_texture_sizes.emplace_back(width, height);
+    }
+
+    void FilterSet::add_extension(const std::string& extension)
+    {
+        this->m_extensions.push_back(extension);
+    }
+
+    void FilterSet::add_path(const fs::path& path)
+    {
+        this->m_paths.push_back(path);
+        size_t node = 0;
+        for (const auto& part : path) {
+            auto& children = this->m_path_nodes[node].children;
+            auto found = children.find(part.string());
+            if (found != children.end()) {
+                node = found->second;
+            } else {
+                size_t child = this->m_path_nodes.size();
+                children.emplace(part.string(), child);
+                this->m_path_nodes.emplace_back();
+                node = child;
+            }
+        }
+        this->m_path_nodes[node].terminal = true;
+    }
+
+    void FilterSet::add_pattern(const std::string& regex)
+    {
+        this->m_patterns.add(regex);
+    }
+
+    void FilterSet::add_image_size(uint32_t width, uint32_t height)
+    {
+        this->m_image_sizes.emplace_back(width, height);
+    }
+
+    void FilterSet::add_image_npot()
+    {
+        this->m_image_npot = true;
+    }
+
+    void FilterSet::add_image_opaque()
+    {
+        this->m_image_opaque = true;
+    }
+
+    void FilterSet::add_image_paletted()
+    {
+        this->m_image_paletted = true;
+    }
+
+    void FilterSet::add_image_solid()
+    {
+        this->m_image_solid = true;
+    }
+
+    void FilterSet::set_image_cache(ImageInfoCache* cache)
+    {
+        this->m_image_cache = cache;
+    }
+
+    std::string FilterSet::texture_query() const
+    {
+        std::vector<std::string> terms;
+        if (this->m_mipmap) {
+            terms.push_back("mip IS NOT NULL");
+        }
+        if (this->m_texture_formats != 0) {
+            std::string formats;
+            for (uint32_t format = 0; format < 32; ++format) {
+                if (this->m_texture_formats & (uint32_t(1) << format)) {
+                    formats += (formats.empty() ? "" : ", ")
+                        + std::to_string(format);
+                }
+            }
+            terms.push_back("tex_format IN (" + formats + ")");
+        }
+        for (const auto& size : this->m_texture_sizes) {
+            terms.push_back("tex_width <= " + std::to_string(size.first)
+                + " AND tex_height <= " + std::to_string(size.second));
+        }
+        // SQLite does not combine partial indexes for terms joined by OR,
+        // so every term gets its own SELECT instead
+        for (auto& term : terms) {
+            term = "SELECT name FROM images WHERE " + term;
+        }
+        return boost::algorithm::join(terms, " UNION ALL ");
+    }
+
+    void FilterSet::remove_texture_rules()
+    {
+        this->m_mipmap = false;
+        this->m_texture_formats = 0;
+        this->m_texture_sizes.clear();
+    }
+
+    bool FilterSet::match_texture(boost::string_view filename) const
+    {
+        if (this->m_texture_formats == 0 && this->m_texture_sizes.empty()) {
+            return false;
+        }
+        auto texture = parse_texture_name(filename);
+        if (!texture) {
+            return false;
+        }
+        if (this->m_texture_formats & (uint32_t(1) << texture->format)) {
+            return true;
+        }
+        for (const auto& size : this->m_texture_sizes) {
+            if (texture->width <= size.first
+            && texture->height <= size.second) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool FilterSet::needs_image_info() const
+    {
+        return !this->m_image_sizes.empty() || this->m_image_npot
+            || this->m_image_opaque || this->m_image_paletted
+            || this->m_image_solid;
+    }
+
+    bool FilterSet::match_image(const fs::path& path) const
+    {
+        if (!this->needs_image_info()) {
+            return false;
+        }
+        auto info = this->m_image_cache ? this->m_image_cache->get(path)
+            : read_image_info(path);
+        if (info.format == IMAGE_UNKNOWN) {
+            return false;
+        }
+        for (const auto& size : this->m_image_sizes) {
+            if (info.width <= size.first && info.height <= size.second) {
+                return true;
+            }
+        }
+        if (this->m_image_npot && !(is_power_of_two(info.width)
+        && is_power_of_two(info.height))) {
+            return true;
+        }
+        if ((this->m_image_opaque && !info.alpha)
+        || (this->m_image_paletted && info.paletted)) {
+            return true;
+        }
+        // Decoding is by far the slowest rule, so it goes last
+        if (this->m_image_solid && info.solid == SOLID_UNKNOWN) {
+            info.solid = this->m_image_cache
+                ? this->m_image_cache->get(path, true).solid
+                : read_image_solid(path, info);
+        }
+        return this->m_image_solid && info.solid == SOLID_YES;
+    }
+
+    bool FilterSet::match_path(const fs::path& base, const fs::path& path)
+        const
+    {
+        if (this->m_paths.empty()) {
+            return false;
+        }
+        // Files found by a Scanner always start with base, so the rest of
+        // the path can be walked through the trie without splitting it into
+        // fs::path components.
+        const std::string& native = path.native();
+        const std::string& prefix = base.native();
+        size_t start = prefix.size();
+        if (native.compare(0, prefix.size(), prefix) != 0
+        || prefix.empty()) {
+            start = std::string::npos;
+        } else if (prefix.back() != '/') {
+            if (native.size() > start && native[start] != '/') {
+                start = std::string::npos;
+            } else {
+                ++ start;
+            }
+        }
+        if (start == std::string::npos) {
+            for (const auto& filter_path : this->m_paths) {
+                if (core::is_path_within_path(path, base/filter_path)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        boost::string_view rest(native);
+        size_t node = 0;
+        while (start < rest.size()) {
+            size_t end = rest.find('/', start);
+            if (end == boost::string_view::npos) {
+                end = rest.size();
+            }
+            const auto& children = this->m_path_nodes[node].children;
+            auto found = children.find(rest.substr(start, end - start));
+            if (found == children.end()) {
+                return false;
+            }
+            node = found->second;
+            if (this->m_path_nodes[node].terminal) {
+                return true;
+            }
+            start = end + 1;
+        }
+        return false;
+    }
+
+    bool FilterSet::filter(const fs::path& base, const fs::path& path) const
+    {
+        auto filename = get_filename_view(path);
+        if (this->m_mipmap && is_mipmap_name(filename)) {
+            return true;
+        }
+        if (this->match_texture(filename)) {
+            return true;
+        }
+        if (!this->m_extensions.empty()) {
+            auto extension = get_extension(filename);
+            if (extension.empty()) {
+                extension = ".";
+            }
+            for (const auto& filter_extension : this->m_extensions) {
+                if (extension == filter_extension) {
+                    return true;
+                }
+            }
+        }
+        if (!this->m_patterns.empty() && this->m_patterns.match(filename)) {
+            return true;
+        }
+        if (this->match_path(base, path)) {
+            return true;
+        }
+        for (const auto& filter : this->m_others) {
+            if (filter.filter(base, path)) {
+                return true;
+            }
+        }
+        return this->match_image(path);
+    }
+
+    bool FilterSet::prune(const fs::path& base, const fs::path& path) const
+    {
+        if (this->match_path(base, path)) {
+            return true;
+        }
+        for (const auto& filter : this->m_others) {
+            if (filter.prune(base, path)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool FilterSet::empty() const
+    {
+        return !this->m_mipmap && this->m_texture_formats == 0
+            && this->m_texture_sizes.empty() && this->m_extensions.empty()
+            && this->m_paths.empty() && this->m_patterns.empty()
+            && !this->needs_image_info() && this->m_others.empty();
+    }
+
     // Filter Factory
     FilterFactory::FilterFactory()
     : m_filters({
         FILTER("mipmap", FilterMipMap, false, "Remove MipMaps"),
         FILTER("filetype", FilterType, true, "Remove files of this filetype"),
-        FILTER("path", FilterPath, true, "Remove files from this path")
+        FILTER("path", FilterPath, true, "Remove files from this path"),
+        FILTER("glob", FilterGlob, true,
+            "Remove files whose names match this glob"),
+        FILTER("regex", FilterRegex, true,
+            "Remove files whose names match this regular expression"),
+        FILTER("size", FilterSize, true,
+            "Remove images no larger than this size, such as 8x8"),
+        FILTER("format", FilterFormat, true,
+            "Remove Dolphin textures of this format, such as cmpr"),
+        FILTER("texsize", FilterTextureSize, true,
+            "Remove Dolphin textures no larger than this size in the game"),
+        FILTER("npot", FilterNonPowerOfTwo, false,
+            "Remove images whose sizes are not powers of two"),
+        FILTER("opaque", FilterOpaque, false,
+            "Remove images without an alpha channel"),
+        FILTER("paletted", FilterPaletted, false,
+            "Remove images that use a palette"),
+        FILTER("solid", FilterSolid, false,
+            "Remove images that are one color or fully transparent")
     }) {}
 
     Filter FilterFactory::create(const std::string& name, const std::string& str) const
@@ -4,15 +4,32 @@
 #include <memory>
 #include <map>
 #include <functional>
+#include <vector>
 #include <boost/filesystem.hpp>
+#include <boost/utility/string_view.hpp>
+#include "imageinfo.h"
+#include "pattern.h"
+#include "texname.h"
 namespace fs = boost::filesystem;
 
 namespace core {
+    class FilterSet;
+
+    /// Returns true if the stem of a file name ends with _mip followed by one
+    /// or more digits.
+    bool is_mipmap_name(boost::string_view filename);
+
     /// An interface for defining filters.
     class IFilter {
     public:
         /// Return false if path should be ignored.
         virtual bool filter(const fs::path& base, const fs::path& path) const = 0;
+        /// Return true if every file inside of the folder path would be
+        /// filtered, so that the folder does not need to be read at all.
+        virtual bool prune(const fs::path& base, const fs::path& path) const;
+        /// Add this filter's rules to set, and return true. Filters that
+        /// return false are kept by the set and called one by one instead.
+        virtual bool compile(FilterSet& set) const;
         /// Serialize this filter into a string.
         virtual std::string serialize() const = 0;
         // All filters require a static deserialize function that return a unique
@@ -24,6 +41,7 @@ namespace core {
     public:
         static std::unique_ptr<IFilter> deserialize(const std::string&);
         bool filter(const fs::path& base, const fs::path& path) const;
+        bool compile(FilterSet& set) const;
         std::string serialize() const;
     };
 
@@ -33,6 +51,7 @@ namespace core {
     public:
         static std::unique_ptr<IFilter> deserialize(const std::string&);
         bool filter(const fs::path& base, const fs::path& path) const;
+        bool compile(FilterSet& set) const;
         std::string serialize() const;
     };
 
@@ -45,6 +64,108 @@ namespace core {
     public:
         static std::unique_ptr<IFilter> deserialize(const std::string&);
         bool filter(const fs::path& base, const fs::path& path) const;
+        bool prune(const fs::path& base, const fs::path& path) const;
+        bool compile(FilterSet& set) const;
+        std::string serialize() const;
+    };
+
+    /// Filter out images whose file name matches a glob, such as
+    /// tex1_4x4_*. See glob_to_regex for the syntax.
+    class FilterGlob : public IFilter {
+        std::string m_glob;
+        PatternSet m_pattern;
+    public:
+        static std::unique_ptr<IFilter> deserialize(const std::string&);
+        bool filter(const fs::path& base, const fs::path& path) const;
+        bool compile(FilterSet& set) const;
+        std::string serialize() const;
+    };
+
+    /// Filter out images whose whole file name matches a regular
+    /// expression. See PatternSet for the syntax.
+    class FilterRegex : public IFilter {
+        std::string m_regex;
+        PatternSet m_pattern;
+    public:
+        static std::unique_ptr<IFilter> deserialize(const std::string&);
+        bool filter(const fs::path& base, const fs::path& path) const;
+        bool compile(FilterSet& set) const;
+        std::string serialize() const;
+    };
+
+    /// Filter out images that are no larger than a given size, written as
+    /// WxH, or just W for a square. Only the image header is read.
+    class FilterSize : public IFilter {
+        uint32_t m_width;
+        uint32_t m_height;
+    public:
+        static std::unique_ptr<IFilter> deserialize(const std::string&);
+        bool filter(const fs::path& base, const fs::path& path) const;
+        bool compile(FilterSet& set) const;
+        std::string serialize() const;
+    };
+
+    /// Filter out textures dumped by Dolphin in a given format, such as cmpr.
+    /// The format is read from the name.
+    class FilterFormat : public IFilter {
+        texture_format_t m_format;
+    public:
+        static std::unique_ptr<IFilter> deserialize(const std::string&);
+        bool filter(const fs::path& base, const fs::path& path) const;
+        bool compile(FilterSet& set) const;
+        std::string serialize() const;
+    };
+
+    /// Filter out textures dumped by Dolphin that are no larger than a
+    /// given size in the game, written as WxH, or just W for a square.
+    /// The size is read from the name, so textures keep their size in the
+    /// game even after they are repainted at a higher resolution.
+    class FilterTextureSize : public IFilter {
+        uint32_t m_width;
+        uint32_t m_height;
+    public:
+        static std::unique_ptr<IFilter> deserialize(const std::string&);
+        bool filter(const fs::path& base, const fs::path& path) const;
+        bool compile(FilterSet& set) const;
+        std::string serialize() const;
+    };
+
+    /// Filter out images whose width or height is not a power of two.
+    class FilterNonPowerOfTwo : public IFilter {
+    public:
+        static std::unique_ptr<IFilter> deserialize(const std::string&);
+        bool filter(const fs::path& base, const fs::path& path) const;
+        bool compile(FilterSet& set) const;
+        std::string serialize() const;
+    };
+
+    /// Filter out images that have no alpha channel, and so can not have
+    /// any transparent pixels.
+    class FilterOpaque : public IFilter {
+    public:
+        static std::unique_ptr<IFilter> deserialize(const std::string&);
+        bool filter(const fs::path& base, const fs::path& path) const;
+        bool compile(FilterSet& set) const;
+        std::string serialize() const;
+    };
+
+    /// Filter out images that use a color palette.
+    class FilterPaletted : public IFilter {
+    public:
+        static std::unique_ptr<IFilter> deserialize(const std::string&);
+        bool filter(const fs::path& base, const fs::path& path) const;
+        bool compile(FilterSet& set) const;
+        std::string serialize() const;
+    };
+
+    /// Filter out images where every pixel has the same color, or every
+    /// pixel is fully transparent. Unlike other image filters, this has to
+    /// decode the image.
+    class FilterSolid : public IFilter {
+    public:
+        static std::unique_ptr<IFilter> deserialize(const std::string&);
+        bool filter(const fs::path& base, const fs::path& path) const;
+        bool compile(FilterSet& set) const;
         std::string serialize() const;
     };
 
@@ -69,6 +190,14 @@ namespace core {
         bool filter(const fs::path& base, const fs::path& path) const;
         bool operator()(const fs::path& base, const fs::path& path) const;
 
+        /// Returns true if every file inside of the folder path would be
+        /// filtered.
+        bool prune(const fs::path& base, const fs::path& path) const;
+
+        /// Add this filter's rules to set. Returns false if it can not be
+        /// compiled.
+        bool compile(FilterSet& set) const;
+
         /// Get the name of this filter.
         const std::string& get_name() const;
 
@@ -83,6 +212,112 @@ namespace core {
         bool is_name_valid() const;
     };
 
+    /// A set of filters compiled into a single matcher.
+    /// Instead of asking every filter about every file, the rules of all
+    /// filters are merged: mipmap detection is a scan of the file name,
+    /// extensions are compared in place, paths are looked up in a trie of
+    /// path components, every name pattern is matched by one DFA, and
+    /// Dolphin names are parsed at most once, all without allocating. Rules
+    /// about image headers are checked last, so that headers are only read
+    /// for files that pass every other rule.
+    /// Filters that can not be compiled are still called one by one.
+    class FilterSet {
+        /// A node of the path trie. Children are keyed by path component.
+        struct PathNode {
+            std::map<std::string, size_t, std::less<>> children;
+            bool terminal = false;
+        };
+        bool m_mipmap;
+        /// Bit n is set if texture format n is filtered out.
+        uint32_t m_texture_formats;
+        /// Textures no larger than any of these sizes are filtered out.
+        std::vector<std::pair<uint32_t, uint32_t>> m_texture_sizes;
+        /// Only a handful of extensions are ever filtered, so a short list
+        /// beats hashing every extension.
+        std::vector<std::string> m_extensions;
+        /// Original paths, for paths that do not start with base.
+        std::vector<fs::path> m_paths;
+        std::vector<PathNode> m_path_nodes;
+        PatternSet m_patterns;
+        /// Images no larger than any of these sizes are filtered out.
+        std::vector<std::pair<uint32_t, uint32_t>> m_image_sizes;
+        bool m_image_npot;
+        bool m_image_opaque;
+        bool m_image_paletted;
+        bool m_image_solid;
+        ImageInfoCache* m_image_cache;
+        std::vector<Filter> m_others;
+        /// Returns true if path is within base joined with any path.
+        bool match_path(const fs::path& base, const fs::path& path) const;
+        /// Returns true if the Dolphin name of a file matches any rule.
+        bool match_texture(boost::string_view filename) const;
+    public:
+        FilterSet();
+
+        /// Add a filter to this set.
+        void add(Filter filter);
+
+        /// Returns true if path should be ignored. Safe to call from many
+        /// threads at once.
+        bool filter(const fs::path& base, const fs::path& path) const;
+
+        /// Returns true if every file inside of the folder path would be
+        /// ignored. Safe to call from many threads at once.
+        bool prune(const fs::path& base, const fs::path& path) const;
+
+        /// Returns true if the header of the image at path matches any rule.
+        /// filter already checks this, along with every other rule.
+        bool match_image(const fs::path& path) const;
+
+        /// Returns true if this set ignores nothing.
+        bool empty() const;
+
+        /// Returns true if this set needs to read image headers.
+        bool needs_image_info() const;
+
+        /// Get an SQL query that selects the name of every registered image
+        /// that the rules about names filter out, that is the mipmap,
+        /// format and texture size rules. Each rule is a separate lookup in
+        /// an index of the images table, so a name may be selected more
+        /// than once. Returns an empty string if there are no such rules.
+        std::string texture_query() const;
+
+        /// Stop checking the rules that texture_query covers, once a
+        /// query has already applied them.
+        void remove_texture_rules();
+
+        /// Look up image headers in a cache instead of reading them every
+        /// time. The cache must outlive any calls to filter.
+        void set_image_cache(ImageInfoCache* cache);
+
+        /// Filter out files whose names are mipmaps.
+        void add_mipmap();
+        /// Filter out Dolphin textures in the given format.
+        void add_texture_format(texture_format_t format);
+        /// Filter out Dolphin textures whose width in the game is at most
+        /// width, and whose height is at most height.
+        void add_texture_size(uint32_t width, uint32_t height);
+        /// Filter out files with the given extension, including the dot.
+        /// The extension "." also filters out files without an extension.
+        void add_extension(const std::string& extension);
+        /// Filter out files within the relative path, relative to base.
+        void add_path(const fs::path& path);
+        /// Filter out files whose name matches a regular expression.
+        /// Throws std::invalid_argument if regex is not valid.
+        void add_pattern(const std::string& regex);
+        /// Filter out images whose width is at most width, and whose height
+        /// is at most height.
+        void add_image_size(uint32_t width, uint32_t height);
+        /// Filter out images whose dimensions are not powers of two.
+        void add_image_npot();
+        /// Filter out images without alpha.
+        void add_image_opaque();
+        /// Filter out images with a palette.
+        void add_image_paletted();
+        /// Filter out images that are a single color or fully transparent.
+        void add_image_solid();
+    };
+
     /// Factory for creating filters.
     class FilterFactory {
         std::map<std::string, FilterDef> m_filters;
@@ -0,0 +1,86 @@
+#include "filterfunction.h"
+#include <stdexcept>
+
+namespace core {
+    const char* const FilterFunction::name = "rb_filtered";
+
+    namespace {
+        void filtered_func(sqlite3_context* context, int argc,
+            sqlite3_value** argv)
+        {
+            auto function = static_cast<const FilterFunction*>(
+                sqlite3_user_data(context));
+            const unsigned char* args[3];
+            for (int i = 0; i < argc; ++i) {
+                args[i] = sqlite3_value_text(argv[i]);
+                if (!args[i]) {
+                    sqlite3_result_null(context);
+                    return;
+                }
+            }
+            try {
+                bool filtered = function->filter(
+                    reinterpret_cast<const char*>(args[0]),
+                    reinterpret_cast<const char*>(args[1]),
+                    reinterpret_cast<const char*>(args[2]));
+                sqlite3_result_int(context, filtered);
+            } catch (const std::exception& e) {
+                sqlite3_result_error(context, e.what(), -1);
+            }
+        }
+    }
+
+    FilterFunction::FilterFunction(database::Database& db)
+    : m_db(db.get_ptr())
+    {
+        int rc = sqlite3_create_function_v2(this->m_db, name, 3,
+            SQLITE_UTF8, this, filtered_func, nullptr, nullptr, nullptr);
+        if (rc != SQLITE_OK) {
+            throw std::runtime_error(sqlite3_errmsg(this->m_db));
+        }
+    }
+
+    FilterFunction::~FilterFunction()
+    {
+        // A function without callbacks deletes the existing one
+        sqlite3_create_function_v2(this->m_db, name, 3, SQLITE_UTF8, nullptr,
+            nullptr, nullptr, nullptr, nullptr);
+    }
+
+    void FilterFunction::set_filters(const std::string& kind, FilterSet set)
+    {
+        auto found = this->m_sets.find(kind);
+        if (found != this->m_sets.end()) {
+            found->second = std::move(set);
+        } else {
+            this->m_sets.emplace(kind, std::move(set));
+        }
+    }
+
+    bool FilterFunction::needs_image_info() const
+    {
+        for (const auto& pair : this->m_sets) {
+            if (pair.second.needs_image_info()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void FilterFunction::set_image_cache(ImageInfoCache* cache)
+    {
+        for (auto& pair : this->m_sets) {
+            pair.second.set_image_cache(cache);
+        }
+    }
+
+    bool FilterFunction::filter(const std::string& kind,
+        const fs::path& base, const fs::path& path) const
+    {
+        auto found = this->m_sets.find(kind);
+        if (found == this->m_sets.end()) {
+            throw std::invalid_argument("No filters of kind '" + kind + "'");
+        }
+        return found->second.filter(base, path);
+    }
+}
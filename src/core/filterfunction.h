@@ -0,0 +1,53 @@
+#pragma once
+#include <map>
+#include <string>
+#include <sqlite3.h>
+#include "db/database.h"
+#include "filter.h"
+
+namespace core {
+    /// Makes FilterSets available to SQL, through the function
+    /// rb_filtered(kind, base, path). It returns 1 if the set of the given
+    /// kind, such as "input" or "output", filters out path relative to
+    /// base, and 0 otherwise, so that filters can be applied inside of a
+    /// query, such as
+    ///     SELECT path FROM rb_scan(?1)
+    ///     WHERE NOT rb_filtered('output', ?1, path)
+    /// NULL arguments give NULL. Rules about image headers read the file
+    /// behind every row, so the function is not deterministic, and it is
+    /// best used with an image cache. Sets must not be changed while a
+    /// query that uses them is running.
+    /// The function exists on a connection for as long as this object does.
+    class FilterFunction {
+        sqlite3* m_db;
+        std::map<std::string, FilterSet> m_sets;
+    public:
+        /// Name of the SQL function.
+        static const char* const name;
+
+        /// Register rb_filtered on db, without any sets. Throws an
+        /// exception if it could not be registered.
+        FilterFunction(database::Database& db);
+        ~FilterFunction();
+        // May NOT copy or move a filter function, since SQLite holds a
+        // pointer to it
+        FilterFunction(const FilterFunction& other) = delete;
+        FilterFunction& operator=(const FilterFunction& other) = delete;
+
+        /// Use set for the given kind, replacing any previous set.
+        void set_filters(const std::string& kind, FilterSet set);
+
+        /// Returns true if any set needs to read image headers.
+        bool needs_image_info() const;
+
+        /// Look up image headers in a cache for every set. Pass nullptr to
+        /// stop using a cache. The cache must outlive any queries that use
+        /// rb_filtered.
+        void set_image_cache(ImageInfoCache* cache);
+
+        /// Returns true if path should be ignored by the set of the given
+        /// kind. Throws std::invalid_argument if there is no such set.
+        bool filter(const std::string& kind, const fs::path& base,
+            const fs::path& path) const;
+    };
+}
@@ -0,0 +1,228 @@
+#include "hash.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <boost/filesystem/fstream.hpp>
+
+namespace core {
+    // Size of the buffer used to hash files
+    const size_t HASH_BUFFER_SIZE = 128 * 1024;
+
+    const uint64_t XXH_PRIME_1 = 11400714785074694791ull;
+    const uint64_t XXH_PRIME_2 = 14029467366897019727ull;
+    const uint64_t XXH_PRIME_3 = 1609587929392839161ull;
+    const uint64_t XXH_PRIME_4 = 9650029242287828579ull;
+    const uint64_t XXH_PRIME_5 = 2870177450012600261ull;
+
+    namespace {
+        inline uint64_t rotate_left(uint64_t value, int bits)
+        {
+            return (value << bits) | (value >> (64 - bits));
+        }
+
+        inline uint64_t read_le64(const unsigned char* data)
+        {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            uint64_t ret;
+            std::memcpy(&ret, data, sizeof(ret));
+            return ret;
+#else
+            uint64_t ret = 0;
+            for (int i = 7; i >= 0; --i) {
+                ret = (ret << 8) | data[i];
+            }
+            return ret;
+#endif
+        }
+
+        inline uint32_t read_le32(const unsigned char* data)
+        {
+            return uint32_t(data[0]) | uint32_t(data[1]) << 8
+                | uint32_t(data[2]) << 16 | uint32_t(data[3]) << 24;
+        }
+
+        inline uint64_t xxh_round(uint64_t lane, uint64_t input)
+        {
+            lane += input * XXH_PRIME_2;
+            lane = rotate_left(lane, 31);
+            return lane * XXH_PRIME_1;
+        }
+
+        inline uint64_t xxh_merge(uint64_t hash, uint64_t lane)
+        {
+            hash ^= xxh_round(0, lane);
+            return hash * XXH_PRIME_1 + XXH_PRIME_4;
+        }
+
+        /// Run one 32 byte stripe through the lanes.
+        inline void xxh_stripe(uint64_t* lanes, const unsigned char* data)
+        {
+            lanes[0] = xxh_round(lanes[0], read_le64(data));
+            lanes[1] = xxh_round(lanes[1], read_le64(data + 8));
+            lanes[2] = xxh_round(lanes[2], read_le64(data + 16));
+            lanes[3] = xxh_round(lanes[3], read_le64(data + 24));
+        }
+    }
+
+    bool ContentHash::operator==(const ContentHash& other) const
+    {
+        return this->hash == other.hash && this->size == other.size;
+    }
+
+    bool ContentHash::operator!=(const ContentHash& other) const
+    {
+        return !(*this == other);
+    }
+
+    ContentHasher::ContentHasher()
+    : m_lanes{XXH_PRIME_1 + XXH_PRIME_2, XXH_PRIME_2, 0, 0 - XXH_PRIME_1}
+    , m_buffered(0), m_size(0) {}
+
+    void ContentHasher::update(const void* data, size_t size)
+    {
+        if (size == 0) {
+            return;
+        }
+        auto input = static_cast<const unsigned char*>(data);
+        this->m_size += size;
+        if (this->m_buffered > 0) {
+            size_t fill = sizeof(this->m_buffer) - this->m_buffered;
+            if (size < fill) {
+                std::memcpy(this->m_buffer + this->m_buffered, input, size);
+                this->m_buffered += size;
+                return;
+            }
+            std::memcpy(this->m_buffer + this->m_buffered, input, fill);
+            xxh_stripe(this->m_lanes, this->m_buffer);
+            input += fill;
+            size -= fill;
+            this->m_buffered = 0;
+        }
+        // Keep the lanes in locals, so that they stay in registers
+        uint64_t lanes[4] = {this->m_lanes[0], this->m_lanes[1],
+            this->m_lanes[2], this->m_lanes[3]};
+        while (size >= 32) {
+            xxh_stripe(lanes, input);
+            input += 32;
+            size -= 32;
+        }
+        std::memcpy(this->m_lanes, lanes, sizeof(lanes));
+        std::memcpy(this->m_buffer, input, size);
+        this->m_buffered = size;
+    }
+
+    ContentHash ContentHasher::digest() const
+    {
+        uint64_t hash;
+        if (this->m_size >= 32) {
+            const uint64_t* lanes = this->m_lanes;
+            hash = rotate_left(lanes[0], 1) + rotate_left(lanes[1], 7)
+                + rotate_left(lanes[2], 12) + rotate_left(lanes[3], 18);
+            for (int i = 0; i < 4; ++i) {
+                hash = xxh_merge(hash, lanes[i]);
+            }
+        } else {
+            hash = XXH_PRIME_5;
+        }
+        hash += this->m_size;
+        const unsigned char* data = this->m_buffer;
+        size_t size = this->m_buffered;
+        while (size >= 8) {
+            hash ^= xxh_round(0, read_le64(data));
+            hash = rotate_left(hash, 27) * XXH_PRIME_1 + XXH_PRIME_4;
+            data += 8;
+            size -= 8;
+        }
+        if (size >= 4) {
+            hash ^= uint64_t(read_le32(data)) * XXH_PRIME_1;
+            hash = rotate_left(hash, 23) * XXH_PRIME_2 + XXH_PRIME_3;
+            data += 4;
+            size -= 4;
+        }
+        while (size > 0) {
+            hash ^= *data * XXH_PRIME_5;
+            hash = rotate_left(hash, 11) * XXH_PRIME_1;
+            ++ data;
+            -- size;
+        }
+        hash ^= hash >> 33;
+        hash *= XXH_PRIME_2;
+        hash ^= hash >> 29;
+        hash *= XXH_PRIME_3;
+        hash ^= hash >> 32;
+        ContentHash ret;
+        ret.hash = hash;
+        ret.size = this->m_size;
+        return ret;
+    }
+
+    ContentHash hash_content(const void* data, size_t size)
+    {
+        ContentHasher hasher;
+        hasher.update(data, size);
+        return hasher.digest();
+    }
+
+    ContentHash hash_file(const fs::path& path)
+    {
+        fs::ifstream stream(path, std::ios::binary);
+        if (!stream) {
+            throw fs::filesystem_error("open", path,
+                boost::system::errc::make_error_code(
+                    boost::system::errc::io_error));
+        }
+        std::unique_ptr<char[]> buffer(new char[HASH_BUFFER_SIZE]);
+        ContentHasher hasher;
+        while (stream) {
+            stream.read(buffer.get(), HASH_BUFFER_SIZE);
+            hasher.update(buffer.get(), stream.gcount());
+        }
+        if (stream.bad()) {
+            throw fs::filesystem_error("read", path,
+                boost::system::errc::make_error_code(
+                    boost::system::errc::io_error));
+        }
+        return hasher.digest();
+    }
+
+    std::vector<ContentHash> hash_files(const std::vector<fs::path>& paths,
+        unsigned threads)
+    {
+        std::vector<ContentHash> ret(paths.size());
+        if (threads == 0) {
+            threads = std::thread::hardware_concurrency();
+        }
+        threads = std::max(1u, std::min<unsigned>(threads, paths.size()));
+        std::atomic<size_t> next(0);
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < threads; ++i) {
+            workers.emplace_back([&]() {
+                size_t index;
+                while ((index = next++) < paths.size()) {
+                    try {
+                        ret[index] = hash_file(paths[index]);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(error_mutex);
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                        next = paths.size();
+                    }
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return ret;
+    }
+}
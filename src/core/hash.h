@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <boost/filesystem.hpp>
+namespace fs = boost::filesystem;
+
+namespace core {
+    /// Identifies the contents of a file.
+    struct ContentHash {
+        /// 64-bit XXH64 hash of the contents, with a seed of 0.
+        uint64_t hash = 0;
+        /// Size of the contents, in bytes.
+        uint64_t size = 0;
+
+        bool operator==(const ContentHash& other) const;
+        bool operator!=(const ContentHash& other) const;
+    };
+
+    /// Hashes data that arrives in pieces, such as a file that is being
+    /// copied, so that it never has to be read a second time.
+    /// Pieces may have any size; data is consumed in 32 byte stripes that
+    /// run through four independent lanes.
+    class ContentHasher {
+        uint64_t m_lanes[4];
+        unsigned char m_buffer[32];
+        size_t m_buffered;
+        uint64_t m_size;
+    public:
+        ContentHasher();
+
+        /// Add the next size bytes of data.
+        void update(const void* data, size_t size);
+
+        /// Get the hash of all data so far.
+        ContentHash digest() const;
+    };
+
+    /// Hash a single piece of data.
+    ContentHash hash_content(const void* data, size_t size);
+
+    /// Hash the contents of a file.
+    /// Throws fs::filesystem_error if the file can not be read.
+    ContentHash hash_file(const fs::path& path);
+
+    /// Hash the contents of many files with a pool of threads. A thread
+    /// count of 0 uses one thread per hardware thread. If any file can not
+    /// be read, the remaining files are skipped and the error is rethrown.
+    std::vector<ContentHash> hash_files(const std::vector<fs::path>& paths,
+        unsigned threads = 0);
+}
@@ -0,0 +1,229 @@
+#include "imageinfo.h"
+#include "db/batch.h"
+#include "solid.h"
+#include "util.h"
+#include <cstring>
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <boost/filesystem/fstream.hpp>
+#endif
+
+namespace core {
+    // Bytes read from the start of every image. Enough for the PNG
+    // signature, IHDR and a full palette, or a DDS header.
+    const size_t IMAGE_HEADER_SIZE = 1024;
+
+    const unsigned char PNG_SIGNATURE[8] = {
+        0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    const uint8_t PNG_COLOR_PALETTE = 3;
+    const uint8_t PNG_COLOR_GRAY_ALPHA = 4;
+    const uint8_t PNG_COLOR_RGBA = 6;
+
+    const size_t DDS_HEADER_SIZE = 128;
+    const uint32_t DDPF_ALPHAPIXELS = 0x1;
+    const uint32_t DDPF_FOURCC = 0x4;
+    const uint32_t DDPF_PALETTEINDEXED8 = 0x20;
+
+    namespace {
+        uint32_t read_be32(const unsigned char* data)
+        {
+            return uint32_t(data[0]) << 24 | uint32_t(data[1]) << 16
+                | uint32_t(data[2]) << 8 | uint32_t(data[3]);
+        }
+
+        uint32_t read_le32(const unsigned char* data)
+        {
+            return uint32_t(data[3]) << 24 | uint32_t(data[2]) << 16
+                | uint32_t(data[1]) << 8 | uint32_t(data[0]);
+        }
+
+        bool parse_png(const unsigned char* data, size_t size, ImageInfo& info)
+        {
+            // signature, then IHDR: length, type, width, height, bit depth,
+            // color type, ...
+            if (size < 33 || std::memcmp(data, PNG_SIGNATURE, 8) != 0
+            || std::memcmp(data + 12, "IHDR", 4) != 0) {
+                return false;
+            }
+            info.format = IMAGE_PNG;
+            info.width = read_be32(data + 16);
+            info.height = read_be32(data + 20);
+            uint8_t color = data[25];
+            info.paletted = color == PNG_COLOR_PALETTE;
+            info.alpha = color == PNG_COLOR_GRAY_ALPHA
+                || color == PNG_COLOR_RGBA;
+            if (info.alpha) {
+                return true;
+            }
+            // Other color types can still be transparent through a tRNS chunk,
+            // which must come before the first IDAT chunk.
+            size_t pos = 33;
+            while (pos + 8 <= size) {
+                uint32_t length = read_be32(data + pos);
+                const unsigned char* type = data + pos + 4;
+                if (std::memcmp(type, "tRNS", 4) == 0) {
+                    info.alpha = true;
+                    return true;
+                }
+                if (std::memcmp(type, "IDAT", 4) == 0) {
+                    return true;
+                }
+                pos += size_t(length) + 12;
+            }
+            // The header did not fit, so assume the worst.
+            info.alpha = true;
+            return true;
+        }
+
+        bool parse_dds(const unsigned char* data, size_t size, ImageInfo& info)
+        {
+            if (size < DDS_HEADER_SIZE || std::memcmp(data, "DDS ", 4) != 0
+            || read_le32(data + 4) != 124) {
+                return false;
+            }
+            info.format = IMAGE_DDS;
+            info.height = read_le32(data + 12);
+            info.width = read_le32(data + 16);
+            uint32_t flags = read_le32(data + 80);
+            info.paletted = flags & DDPF_PALETTEINDEXED8;
+            info.alpha = flags & DDPF_ALPHAPIXELS;
+            if (flags & DDPF_FOURCC) {
+                // Compressed formats may all carry alpha, except for those
+                // which only store one or two color channels.
+                const unsigned char* fourcc = data + 84;
+                info.alpha = true;
+                for (const char* opaque : {"ATI1", "ATI2", "BC4U", "BC4S",
+                    "BC5U", "BC5S"}) {
+                    if (std::memcmp(fourcc, opaque, 4) == 0) {
+                        info.alpha = false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        ImageInfo parse_image_info(const unsigned char* data, size_t size)
+        {
+            ImageInfo ret;
+            if (!parse_png(data, size, ret) && !parse_dds(data, size, ret)) {
+                ret = ImageInfo();
+            }
+            return ret;
+        }
+    }
+
+    ImageInfo read_image_info(const fs::path& path)
+    {
+        unsigned char data[IMAGE_HEADER_SIZE];
+#ifdef __linux__
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return ImageInfo();
+        }
+        ssize_t size = pread(fd, data, sizeof(data), 0);
+        close(fd);
+        if (size < 0) {
+            return ImageInfo();
+        }
+#else
+        fs::ifstream stream(path, std::ios::binary);
+        stream.read(reinterpret_cast<char*>(data), sizeof(data));
+        std::streamsize size = stream.gcount();
+#endif
+        return parse_image_info(data, size);
+    }
+
+    ImageInfoCache ImageInfoCache::load(database::Database& db,
+        const std::vector<fs::path>& roots)
+    {
+        ImageInfoCache ret;
+        auto stmt = db.prepare(R"(
+            SELECT path, size, mtime, format, width, height, alpha, paletted,
+                solid
+            FROM imageinfo
+            WHERE path > ?1 || '/' AND path < ?1 || '0'
+        )");
+        for (const auto& root : roots) {
+            stmt.reset();
+            stmt.bind(1, root.string());
+            for (const auto& row : stmt.rows<std::string, int64_t, int64_t,
+                int, int64_t, int64_t, int, int, int>()) {
+                Entry entry;
+                entry.size = std::get<1>(row);
+                entry.mtime = std::get<2>(row);
+                entry.info.format = static_cast<image_format_t>(
+                    std::get<3>(row));
+                entry.info.width = std::get<4>(row);
+                entry.info.height = std::get<5>(row);
+                entry.info.alpha = std::get<6>(row);
+                entry.info.paletted = std::get<7>(row);
+                entry.info.solid = static_cast<image_solid_t>(
+                    std::get<8>(row));
+                ret.m_cache.insert(std::get<0>(row), entry);
+            }
+        }
+        return ret;
+    }
+
+    ImageInfoCache::ImageInfoCache(ImageInfoCache&& other)
+    : m_cache(std::move(other.m_cache)) {}
+
+    ImageInfo ImageInfoCache::get(const fs::path& path, bool solid)
+    {
+        const std::string& key = path.native();
+        Entry entry;
+        try {
+            FileStat stat = get_file_stat(path);
+            entry.size = stat.size;
+            entry.mtime = stat.mtime;
+        } catch (const fs::filesystem_error&) {
+            return ImageInfo();
+        }
+        const Entry* cached = this->m_cache.find(key);
+        if (cached && cached->size == entry.size
+        && cached->mtime == entry.mtime) {
+            entry.info = cached->info;
+            if (!solid || entry.info.solid != SOLID_UNKNOWN) {
+                return entry.info;
+            }
+        } else {
+            entry.info = read_image_info(path);
+        }
+        if (solid) {
+            entry.info.solid = read_image_solid(path, entry.info);
+        }
+        this->m_cache.update(key, entry.mtime, entry);
+        return entry.info;
+    }
+
+    void ImageInfoCache::save(database::Database& db)
+    {
+        auto transaction = db.create_transaction();
+        database::BatchWriter inserts(db, R"(
+            INSERT OR REPLACE INTO imageinfo(path, size, mtime, format,
+                width, height, alpha, paletted, solid)
+            VALUES )", "(?, ?, ?, ?, ?, ?, ?, ?, ?)");
+        for (const auto& pair : this->m_cache.get_updates()) {
+            const auto& info = pair.second.info;
+            inserts.add(pair.first, pair.second.size, pair.second.mtime,
+                static_cast<int>(info.format), static_cast<int64_t>(info.width),
+                static_cast<int64_t>(info.height), static_cast<int>(info.alpha),
+                static_cast<int>(info.paletted),
+                static_cast<int>(info.solid));
+        }
+        inserts.flush();
+        database::BatchWriter deletes(db, R"(
+            DELETE FROM imageinfo
+            WHERE path IN ()", "?", ")");
+        for (const auto& path : this->m_cache.get_unvisited()) {
+            boost::system::error_code error;
+            if (fs::status(path, error).type() == fs::file_not_found) {
+                deletes.add(path);
+            }
+        }
+        deletes.flush();
+        this->m_cache.clear_updates();
+    }
+}
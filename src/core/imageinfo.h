@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "db/database.h"
+#include "pathcache.h"
+namespace fs = boost::filesystem;
+
+namespace core {
+    /// The file format of an image.
+    enum image_format_t {
+        /// Not an image, or an image whose header could not be read.
+        IMAGE_UNKNOWN,
+        IMAGE_PNG,
+        IMAGE_DDS
+    };
+
+    /// Whether every pixel of an image has the same color, or every pixel
+    /// is fully transparent. This takes decoding the whole image, so it is
+    /// only known once somebody asked for it.
+    enum image_solid_t {
+        SOLID_UNKNOWN,
+        SOLID_NO,
+        SOLID_YES
+    };
+
+    /// What can be told about an image from its header, and, once it has
+    /// been decoded, whether it is solid.
+    struct ImageInfo {
+        image_format_t format = IMAGE_UNKNOWN;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        /// False only if the image can not have any transparent pixels.
+        /// Images that might be transparent count as having alpha.
+        bool alpha = false;
+        /// True if the image uses a color palette.
+        bool paletted = false;
+        image_solid_t solid = SOLID_UNKNOWN;
+    };
+
+    /// Read the header of a PNG or DDS image. Only the first kilobyte of
+    /// the file is read, and pixel data is never decoded.
+    /// Files that are not images, or can not be read, get IMAGE_UNKNOWN.
+    ImageInfo read_image_info(const fs::path& path);
+
+    /// Remembers image headers, and whether images are solid, between
+    /// imports.
+    /// Entries are keyed by path, and an entry is only used while the file
+    /// still has the same size and modification time, so unchanged images
+    /// never have their headers read again.
+    /// The cache is stored in the project database.
+    class ImageInfoCache {
+        struct Entry {
+            int64_t size;
+            int64_t mtime;
+            ImageInfo info;
+        };
+        PathCache<Entry> m_cache;
+        ImageInfoCache() = default;
+    public:
+        /// Load the cached headers of every file inside of roots.
+        static ImageInfoCache load(database::Database& db,
+            const std::vector<fs::path>& roots);
+
+        ImageInfoCache(ImageInfoCache&& other);
+
+        /// Get the header of an image, reading it only if the cached entry
+        /// is missing or out of date. If solid is true, the image is also
+        /// decoded to find out whether it is solid, unless that is already
+        /// known. This is thread safe.
+        ImageInfo get(const fs::path& path, bool solid = false);
+
+        /// Write every updated entry back into the database, and remove the
+        /// entries of files that were not looked up and no longer exist.
+        void save(database::Database& db);
+    };
+}
@@ -0,0 +1,250 @@
+#include "nameindex.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <boost/filesystem/fstream.hpp>
+#include "nameset.h"
+
+namespace bip = boost::interprocess;
+
+namespace core {
+    const char NAME_INDEX_MAGIC[8] = {'R', 'B', 'N', 'A', 'M', 'E', 'S', 0};
+    // Changes whenever the layout of the file changes. Since the file is
+    // only a cache, older files are simply rebuilt.
+    const uint32_t NAME_INDEX_VERSION = 1;
+    const size_t NAME_INDEX_MIN_SLOTS = 1024;
+    const uint32_t NAME_INDEX_REMOVED = UINT32_MAX;
+
+    struct NameIndex::Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+        /// Generation of the last commit, or 0 while being modified.
+        uint64_t generation;
+        /// Number of slots, always a power of two.
+        uint64_t slots;
+        /// Slots that are not empty, including removed names.
+        uint64_t used;
+        /// Names in the set.
+        uint64_t live;
+        /// Bytes of name data in use, and available.
+        uint64_t heap_size;
+        uint64_t heap_capacity;
+    };
+
+    /// An empty slot has a hash of 0. Names whose hash is 0 are stored with
+    /// a hash of 1 instead. Removed names keep their hash so that probes
+    /// continue past them, but their offset is NAME_INDEX_REMOVED.
+    struct NameIndex::Slot {
+        uint64_t hash;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    namespace {
+        uint64_t get_slot_hash(boost::string_view name)
+        {
+            uint64_t hash = hash_name(name);
+            return hash == 0 ? 1 : hash;
+        }
+    }
+
+    uint64_t NameIndex::get_file_size(uint64_t slots, uint64_t heap_capacity)
+    {
+        return sizeof(NameIndex::Header) + slots * sizeof(NameIndex::Slot)
+            + heap_capacity;
+    }
+
+    NameIndex::NameIndex(const fs::path& path)
+    : m_path(path) {}
+
+    NameIndex::~NameIndex() {}
+
+    NameIndex::Header& NameIndex::header() const
+    {
+        return *static_cast<Header*>(m_region.get_address());
+    }
+
+    NameIndex::Slot* NameIndex::slots() const
+    {
+        return reinterpret_cast<Slot*>(
+            static_cast<char*>(m_region.get_address()) + sizeof(Header));
+    }
+
+    char* NameIndex::heap() const
+    {
+        return reinterpret_cast<char*>(this->slots() + this->header().slots);
+    }
+
+    void NameIndex::map()
+    {
+        m_file = bip::file_mapping(m_path.c_str(), bip::read_write);
+        m_region = bip::mapped_region(m_file, bip::read_write);
+    }
+
+    std::unique_ptr<NameIndex> NameIndex::open(const fs::path& path,
+        uint64_t generation, uint64_t count)
+    {
+        boost::system::error_code ec;
+        uint64_t file_size = fs::file_size(path, ec);
+        if (ec || file_size < sizeof(Header) || generation == 0) {
+            return nullptr;
+        }
+        std::unique_ptr<NameIndex> ret(new NameIndex(path));
+        try {
+            ret->map();
+        } catch (bip::interprocess_exception&) {
+            return nullptr;
+        }
+        const Header& header = ret->header();
+        if (std::memcmp(header.magic, NAME_INDEX_MAGIC, 8) != 0
+        || header.version != NAME_INDEX_VERSION
+        || header.generation != generation
+        || header.live != count
+        || header.slots == 0 || (header.slots & (header.slots - 1)) != 0
+        || header.heap_size > header.heap_capacity
+        || file_size != get_file_size(header.slots, header.heap_capacity)) {
+            return nullptr;
+        }
+        return ret;
+    }
+
+    std::unique_ptr<NameIndex> NameIndex::create(const fs::path& path,
+        size_t count, size_t size)
+    {
+        // Keep the table at most half full
+        uint64_t slots = NAME_INDEX_MIN_SLOTS;
+        while (slots < count * 2) {
+            slots *= 2;
+        }
+        uint64_t heap_capacity = std::max<uint64_t>(size, slots * 16);
+        if (heap_capacity > UINT32_MAX) {
+            throw std::length_error("Name index is too large");
+        }
+        {
+            fs::ofstream file(path, std::ios::binary | std::ios::trunc);
+            if (!file) {
+                throw std::runtime_error("Could not create " + path.string());
+            }
+        }
+        fs::resize_file(path, get_file_size(slots, heap_capacity));
+        std::unique_ptr<NameIndex> ret(new NameIndex(path));
+        ret->map();
+        Header& header = ret->header();
+        std::memcpy(header.magic, NAME_INDEX_MAGIC, 8);
+        header.version = NAME_INDEX_VERSION;
+        header.generation = 0;
+        header.slots = slots;
+        header.heap_capacity = heap_capacity;
+        return ret;
+    }
+
+    size_t NameIndex::find_slot(boost::string_view name, uint64_t hash) const
+    {
+        const Slot* slots = this->slots();
+        const char* heap = this->heap();
+        size_t mask = this->header().slots - 1;
+        size_t i = static_cast<size_t>(hash ^ (hash >> 32)) & mask;
+        while (true) {
+            const Slot& slot = slots[i];
+            if (slot.hash == 0) {
+                return i;
+            }
+            if (slot.hash == hash && slot.offset != NAME_INDEX_REMOVED
+            && slot.size == name.size()
+            && std::memcmp(heap + slot.offset, name.data(), name.size()) == 0){
+                return i;
+            }
+            i = (i + 1) & mask;
+        }
+    }
+
+    bool NameIndex::contains(boost::string_view name) const
+    {
+        return this->slots()[this->find_slot(name, get_slot_hash(name))].hash
+            != 0;
+    }
+
+    void NameIndex::mark_dirty()
+    {
+        if (this->header().generation != 0) {
+            this->header().generation = 0;
+            m_region.flush(0, sizeof(Header), false);
+        }
+    }
+
+    void NameIndex::reserve(size_t count, size_t size)
+    {
+        const Header& header = this->header();
+        if ((header.used + count) * 2 <= header.slots
+        && header.heap_size + size <= header.heap_capacity) {
+            return;
+        }
+        // Write a larger copy next to this one, and swap it in. Removed
+        // names are dropped along the way.
+        fs::path tmp_path = m_path;
+        tmp_path += ".tmp";
+        auto copy = NameIndex::create(tmp_path,
+            (header.live + count) * 2, (header.heap_size + size) * 2);
+        const Slot* slots = this->slots();
+        const char* heap = this->heap();
+        for (uint64_t i = 0; i < header.slots; ++i) {
+            if (slots[i].hash != 0 && slots[i].offset != NAME_INDEX_REMOVED) {
+                copy->insert(boost::string_view(heap + slots[i].offset,
+                    slots[i].size));
+            }
+        }
+        copy->m_region.flush();
+        copy.reset();
+        m_region = bip::mapped_region();
+        m_file = bip::file_mapping();
+        fs::rename(tmp_path, m_path);
+        this->map();
+    }
+
+    bool NameIndex::insert(boost::string_view name)
+    {
+        uint64_t hash = get_slot_hash(name);
+        if (this->slots()[this->find_slot(name, hash)].hash != 0) {
+            return false;
+        }
+        this->mark_dirty();
+        this->reserve(1, name.size());
+        Header& header = this->header();
+        Slot& slot = this->slots()[this->find_slot(name, hash)];
+        std::memcpy(this->heap() + header.heap_size, name.data(), name.size());
+        slot.hash = hash;
+        slot.offset = header.heap_size;
+        slot.size = name.size();
+        header.heap_size += name.size();
+        ++ header.used;
+        ++ header.live;
+        return true;
+    }
+
+    bool NameIndex::erase(boost::string_view name)
+    {
+        Slot& slot = this->slots()[this->find_slot(name, get_slot_hash(name))];
+        if (slot.hash == 0) {
+            return false;
+        }
+        this->mark_dirty();
+        slot.offset = NAME_INDEX_REMOVED;
+        -- this->header().live;
+        return true;
+    }
+
+    size_t NameIndex::size() const
+    {
+        return this->header().live;
+    }
+
+    void NameIndex::commit(uint64_t generation)
+    {
+        // Everything else must be on disk before the generation is, or a
+        // crash could leave a partially written set that looks valid.
+        m_region.flush(0, 0, false);
+        this->header().generation = generation;
+        m_region.flush(0, sizeof(Header), false);
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/utility/string_view.hpp>
+namespace fs = boost::filesystem;
+
+namespace core {
+    /// A set of names stored in a memory mapped file.
+    /// The file is an open-addressing hash table of names keyed by
+    /// hash_name, followed by the names themselves, so that a lookup is a
+    /// single probe into the mapping, and opening the set does not need to
+    /// read anything up front.
+    /// Every committed state of the set has a generation. The owner stores
+    /// the generation alongside whatever the set mirrors, and only trusts the
+    /// file if the two generations match. While the set is being modified,
+    /// its file has a generation of 0, so that a set which was only partially
+    /// written is never trusted.
+    class NameIndex {
+        struct Header;
+        struct Slot;
+        fs::path m_path;
+        boost::interprocess::file_mapping m_file;
+        boost::interprocess::mapped_region m_region;
+        NameIndex(const fs::path& path);
+        /// Size of a file with the given capacity.
+        static uint64_t get_file_size(uint64_t slots, uint64_t heap_capacity);
+        Header& header() const;
+        Slot* slots() const;
+        char* heap() const;
+        /// Map the file at m_path.
+        void map();
+        /// Find the slot holding name, or the empty slot where it belongs.
+        size_t find_slot(boost::string_view name, uint64_t hash) const;
+        /// Make sure that count more names taking up size more bytes fit,
+        /// by writing a larger copy of this set if necessary.
+        void reserve(size_t count, size_t size);
+        /// Set the generation to 0 before the first change since a commit.
+        void mark_dirty();
+    public:
+        ~NameIndex();
+        NameIndex(const NameIndex&) = delete;
+        NameIndex& operator=(const NameIndex&) = delete;
+
+        /// Open the set stored at path.
+        /// Returns nullptr if the file is missing or damaged, or if it does
+        /// not hold exactly count names at the given generation.
+        static std::unique_ptr<NameIndex> open(const fs::path& path,
+            uint64_t generation, uint64_t count);
+
+        /// Create an empty set at path, replacing any existing file.
+        /// Space is reserved for count names taking up size bytes in total.
+        static std::unique_ptr<NameIndex> create(const fs::path& path,
+            size_t count, size_t size);
+
+        /// Returns true if name is in this set.
+        /// Safe to call from many threads at once, as long as the set is not
+        /// being modified.
+        bool contains(boost::string_view name) const;
+
+        /// Add a name. Returns false if it was already in this set.
+        bool insert(boost::string_view name);
+
+        /// Remove a name. Returns false if it was not in this set.
+        bool erase(boost::string_view name);
+
+        /// Number of names in this set.
+        size_t size() const;
+
+        /// Write all changes to disk and mark them as generation.
+        void commit(uint64_t generation);
+    };
+}
@@ -0,0 +1,153 @@
+#include "nameset.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace core {
+    uint64_t hash_name(const char* data, size_t size)
+    {
+        // 64-bit FNV-1a
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= static_cast<unsigned char>(data[i]);
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    uint64_t hash_name(boost::string_view name)
+    {
+        return hash_name(name.data(), name.size());
+    }
+
+    const size_t NameSet::npos = static_cast<size_t>(-1);
+
+    // Table sizes are always a power of two, and are kept at most half full
+    // so that probe sequences stay short.
+    const size_t MIN_SLOTS = 16;
+
+    NameSet::NameSet()
+    : m_buffer(), m_offsets({0}), m_slots(MIN_SLOTS, 0)
+    , m_slot_hashes(MIN_SLOTS, 0) {}
+
+    NameSet NameSet::from_query(database::Database& db,
+        const std::string& statement)
+    {
+        NameSet ret;
+        auto stmt = db.prepare(statement);
+        for (const auto& row : stmt.rows<boost::string_view>()) {
+            ret.insert(std::get<0>(row));
+        }
+        return ret;
+    }
+
+    size_t NameSet::find_slot(const char* data, size_t size,
+        uint64_t hash) const
+    {
+        size_t mask = this->m_slots.size() - 1;
+        uint32_t short_hash = static_cast<uint32_t>(hash);
+        size_t i = static_cast<size_t>(hash >> 32) & mask;
+        while (true) {
+            uint32_t slot = this->m_slots[i];
+            if (slot == 0) {
+                return i;
+            }
+            if (this->m_slot_hashes[i] == short_hash) {
+                uint32_t start = this->m_offsets[slot - 1];
+                uint32_t end = this->m_offsets[slot];
+                if (end - start == size
+                && std::memcmp(&this->m_buffer[start], data, size) == 0) {
+                    return i;
+                }
+            }
+            i = (i + 1) & mask;
+        }
+    }
+
+    void NameSet::grow()
+    {
+        size_t capacity = this->m_slots.size() * 2;
+        this->m_slots.assign(capacity, 0);
+        this->m_slot_hashes.assign(capacity, 0);
+        size_t mask = capacity - 1;
+        for (size_t index = 0; index < this->size(); ++index) {
+            uint32_t start = this->m_offsets[index];
+            uint32_t end = this->m_offsets[index + 1];
+            uint64_t hash = hash_name(this->m_buffer.data() + start,
+                end - start);
+            size_t i = static_cast<size_t>(hash >> 32) & mask;
+            while (this->m_slots[i] != 0) {
+                i = (i + 1) & mask;
+            }
+            this->m_slots[i] = index + 1;
+            this->m_slot_hashes[i] = static_cast<uint32_t>(hash);
+        }
+    }
+
+    void NameSet::reserve(size_t n)
+    {
+        this->m_offsets.reserve(n + 1);
+        if (n * 2 > this->m_slots.size()) {
+            size_t capacity = this->m_slots.size();
+            while (n * 2 > capacity) {
+                capacity *= 2;
+            }
+            // grow() doubles, so start from half of the target size.
+            this->m_slots.resize(capacity / 2);
+            this->grow();
+        }
+    }
+
+    std::pair<size_t, bool> NameSet::insert(boost::string_view name)
+    {
+        uint64_t hash = hash_name(name);
+        size_t i = this->find_slot(name.data(), name.size(), hash);
+        if (this->m_slots[i] != 0) {
+            return {this->m_slots[i] - 1, false};
+        }
+        if (this->m_buffer.size() + name.size() > UINT32_MAX) {
+            throw std::length_error("NameSet is too large");
+        }
+        size_t index = this->size();
+        this->m_buffer.insert(this->m_buffer.end(), name.begin(), name.end());
+        this->m_offsets.push_back(this->m_buffer.size());
+        if ((index + 1) * 2 > this->m_slots.size()) {
+            this->grow();
+        } else {
+            this->m_slots[i] = index + 1;
+            this->m_slot_hashes[i] = static_cast<uint32_t>(hash);
+        }
+        return {index, true};
+    }
+
+    size_t NameSet::find(boost::string_view name) const
+    {
+        uint64_t hash = hash_name(name);
+        size_t i = this->find_slot(name.data(), name.size(), hash);
+        if (this->m_slots[i] == 0) {
+            return npos;
+        }
+        return this->m_slots[i] - 1;
+    }
+
+    bool NameSet::contains(boost::string_view name) const
+    {
+        return this->find(name) != npos;
+    }
+
+    std::string NameSet::at(size_t index) const
+    {
+        uint32_t start = this->m_offsets.at(index);
+        uint32_t end = this->m_offsets.at(index + 1);
+        return std::string(this->m_buffer.data() + start, end - start);
+    }
+
+    size_t NameSet::size() const
+    {
+        return this->m_offsets.size() - 1;
+    }
+
+    bool NameSet::empty() const
+    {
+        return this->size() == 0;
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/utility/string_view.hpp>
+#include "db/database.h"
+
+namespace core {
+    /// Hash a string. This hash is stable across runs and platforms, so it
+    /// may be stored on disk.
+    uint64_t hash_name(const char* data, size_t size);
+    uint64_t hash_name(boost::string_view name);
+
+    /// A compact set of names.
+    /// All names are packed into a single buffer, and lookups go through an
+    /// open-addressing table of indices, so that even sets of several hundred
+    /// thousand names only need a handful of allocations. Every name is given
+    /// an index, in the order in which names were inserted, which can be used
+    /// to attach extra data to names with a plain vector.
+    class NameSet {
+        std::vector<char> m_buffer; /// Packed name data
+        std::vector<uint32_t> m_offsets; /// Start of each name in m_buffer
+        std::vector<uint32_t> m_slots; /// Name index + 1, or 0 if empty
+        std::vector<uint32_t> m_slot_hashes; /// Lower bits of each slot's hash
+        void grow();
+        size_t find_slot(const char* data, size_t size, uint64_t hash) const;
+    public:
+        /// Returned by find if a name is not in this set.
+        static const size_t npos;
+
+        NameSet();
+
+        /// Create a set from the first column of every row of a query.
+        static NameSet from_query(database::Database& db,
+            const std::string& statement);
+
+        /// Reserve space for at least n names.
+        void reserve(size_t n);
+
+        /// Insert a name into this set.
+        /// Returns the index of the name, and whether it was newly inserted.
+        std::pair<size_t, bool> insert(boost::string_view name);
+
+        /// Get the index of a name, or npos if it is not in this set.
+        size_t find(boost::string_view name) const;
+
+        /// Returns true if a name is in this set.
+        bool contains(boost::string_view name) const;
+
+        /// Get the name with the given index.
+        std::string at(size_t index) const;
+
+        /// Number of names in this set.
+        size_t size() const;
+
+        /// Returns true if there are no names in this set.
+        bool empty() const;
+    };
+}
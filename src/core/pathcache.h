@@ -0,0 +1,100 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace core {
+    /// Entries are not stored for paths modified this close to the time
+    /// that a cache was loaded, since they may be modified again within the
+    /// same timestamp tick without their modification time changing.
+    const int64_t PATH_CACHE_RACY_NS = 2000000000;
+
+    /// Entries about files or folders, keyed by path, that are loaded from
+    /// the project database, looked up and updated by many threads at once,
+    /// and then written back. Each entry remembers the modification time it
+    /// was made for, and callers compare that against the current one.
+    /// Used by ScanCache and ImageInfoCache, which do their own loading and
+    /// saving.
+    template<typename Entry>
+    class PathCache {
+        std::unordered_map<std::string, Entry> m_entries;
+        std::unordered_map<std::string, Entry> m_updates;
+        std::unordered_set<std::string> m_visited;
+        std::mutex m_mutex;
+        int64_t m_started;
+    public:
+        /// Create an empty cache, loaded now.
+        PathCache()
+        : m_started(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count()) {}
+
+        PathCache(PathCache&& other)
+        : m_entries(std::move(other.m_entries))
+        , m_updates(std::move(other.m_updates))
+        , m_visited(std::move(other.m_visited))
+        , m_started(other.m_started) {}
+
+        /// Add an entry that was loaded. Not thread safe.
+        void insert(std::string path, Entry entry)
+        {
+            this->m_entries.emplace(std::move(path), std::move(entry));
+        }
+
+        /// Mark path as visited, and get its loaded entry, or nullptr if
+        /// there is none. This is thread safe.
+        const Entry* find(const std::string& path)
+        {
+            {
+                std::lock_guard<std::mutex> lock(this->m_mutex);
+                this->m_visited.insert(path);
+            }
+            // m_entries is never modified while entries are looked up
+            auto iter = this->m_entries.find(path);
+            if (iter == this->m_entries.end()) {
+                return nullptr;
+            }
+            return &iter->second;
+        }
+
+        /// Record a new entry for path, unless mtime is too recent to be
+        /// trusted. This is thread safe.
+        void update(const std::string& path, int64_t mtime, Entry entry)
+        {
+            if (mtime > this->m_started - PATH_CACHE_RACY_NS) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(this->m_mutex);
+            this->m_updates[path] = std::move(entry);
+        }
+
+        /// Get every entry that was updated since the last call to
+        /// clear_updates.
+        const std::unordered_map<std::string, Entry>& get_updates() const
+        {
+            return this->m_updates;
+        }
+
+        /// Forget the updated entries, once they have been saved.
+        void clear_updates()
+        {
+            this->m_updates.clear();
+        }
+
+        /// Get the path of every loaded entry that was never looked up.
+        std::vector<std::string> get_unvisited() const
+        {
+            std::vector<std::string> ret;
+            for (const auto& pair : this->m_entries) {
+                if (this->m_visited.count(pair.first) == 0) {
+                    ret.push_back(pair.first);
+                }
+            }
+            return ret;
+        }
+    };
+}
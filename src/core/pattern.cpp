@@ -0,0 +1,634 @@
+#include "pattern.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <stdexcept>
+
+namespace core {
+    // Patterns whose DFA would need more states than this are matched by
+    // simulating their NFA instead.
+    const size_t PATTERN_MAX_DFA_STATES = 4096;
+    // The same, for the total number of NFA states in the sets of states
+    // that make up the DFA while it is built.
+    const size_t PATTERN_MAX_DFA_SETS = 1 << 20;
+    // Most NFA states in a set. Nested repetitions such as (a{100}){100}
+    // grow quickly, so sets that need more are rejected.
+    const size_t PATTERN_MAX_NFA_STATES = 1 << 16;
+    // Largest count allowed in a {n,m} repetition.
+    const int PATTERN_MAX_REPEAT = 255;
+
+    namespace {
+        /// A parsed regular expression.
+        struct Node {
+            enum Type {CHARS, CONCAT, ALT, REPEAT, EMPTY};
+            Type type;
+            std::bitset<256> chars;
+            std::vector<std::unique_ptr<Node>> children;
+            int min = 0;
+            /// -1 for no limit
+            int max = 0;
+            Node(Type type) : type(type) {}
+        };
+        using NodePtr = std::unique_ptr<Node>;
+
+        NodePtr make_chars(const std::bitset<256>& chars)
+        {
+            NodePtr ret(new Node(Node::CHARS));
+            ret->chars = chars;
+            return ret;
+        }
+
+        std::bitset<256> get_byte_set(unsigned char c)
+        {
+            std::bitset<256> ret;
+            ret.set(c);
+            return ret;
+        }
+
+        std::bitset<256> get_escape_set(char c, bool& found)
+        {
+            std::bitset<256> ret;
+            found = true;
+            switch (c) {
+            case 'd': case 'D':
+                for (int i = '0'; i <= '9'; ++i) ret.set(i);
+                break;
+            case 'w': case 'W':
+                for (int i = '0'; i <= '9'; ++i) ret.set(i);
+                for (int i = 'a'; i <= 'z'; ++i) ret.set(i);
+                for (int i = 'A'; i <= 'Z'; ++i) ret.set(i);
+                ret.set('_');
+                break;
+            case 's': case 'S':
+                for (char space : {' ', '\t', '\n', '\r', '\f', '\v'}) {
+                    ret.set(static_cast<unsigned char>(space));
+                }
+                break;
+            default:
+                found = false;
+                return ret;
+            }
+            if (c == 'D' || c == 'W' || c == 'S') {
+                ret.flip();
+            }
+            return ret;
+        }
+
+        /// Recursive descent parser for PatternSet's regular expressions.
+        class Parser {
+            const std::string& m_text;
+            size_t m_pos;
+            size_t m_end;
+
+            [[noreturn]] void fail(const std::string& what) const
+            {
+                throw std::invalid_argument("Invalid pattern '" + m_text
+                    + "': " + what);
+            }
+
+            bool at_end() const
+            {
+                return m_pos >= m_end;
+            }
+
+            char peek() const
+            {
+                return m_text[m_pos];
+            }
+
+            /// Read the character after a backslash, as a set of bytes.
+            std::bitset<256> parse_escape()
+            {
+                if (this->at_end()) {
+                    this->fail("trailing backslash");
+                }
+                char c = m_text[m_pos++];
+                bool found;
+                auto ret = get_escape_set(c, found);
+                if (found) {
+                    return ret;
+                }
+                switch (c) {
+                case 'n': return get_byte_set('\n');
+                case 't': return get_byte_set('\t');
+                case 'r': return get_byte_set('\r');
+                case 'f': return get_byte_set('\f');
+                case 'v': return get_byte_set('\v');
+                }
+                if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+                || (c >= '0' && c <= '9')) {
+                    this->fail(std::string("unsupported escape \\") + c);
+                }
+                return get_byte_set(c);
+            }
+
+            /// Read a single member of a character class. Sets is_byte if
+            /// the member is a single byte, which may start a range.
+            std::bitset<256> parse_class_member(bool& is_byte,
+                unsigned char& byte)
+            {
+                char c = m_text[m_pos++];
+                if (c == '\\') {
+                    auto ret = this->parse_escape();
+                    is_byte = ret.count() == 1;
+                    if (is_byte) {
+                        for (int i = 0; i < 256; ++i) {
+                            if (ret.test(i)) byte = i;
+                        }
+                    }
+                    return ret;
+                }
+                is_byte = true;
+                byte = c;
+                return get_byte_set(c);
+            }
+
+            NodePtr parse_class()
+            {
+                bool negate = false;
+                if (!this->at_end() && this->peek() == '^') {
+                    negate = true;
+                    ++ m_pos;
+                }
+                std::bitset<256> chars;
+                bool first = true;
+                while (true) {
+                    if (this->at_end()) {
+                        this->fail("missing ]");
+                    }
+                    if (this->peek() == ']' && !first) {
+                        ++ m_pos;
+                        break;
+                    }
+                    first = false;
+                    bool is_byte;
+                    unsigned char low;
+                    auto member = this->parse_class_member(is_byte, low);
+                    if (is_byte && m_pos + 1 < m_end && this->peek() == '-'
+                    && m_text[m_pos + 1] != ']') {
+                        ++ m_pos;
+                        bool high_is_byte;
+                        unsigned char high;
+                        this->parse_class_member(high_is_byte, high);
+                        if (!high_is_byte || high < low) {
+                            this->fail("invalid range in []");
+                        }
+                        for (int i = low; i <= high; ++i) {
+                            chars.set(i);
+                        }
+                    } else {
+                        chars |= member;
+                    }
+                }
+                if (negate) {
+                    chars.flip();
+                }
+                return make_chars(chars);
+            }
+
+            NodePtr parse_atom()
+            {
+                char c = m_text[m_pos++];
+                switch (c) {
+                case '(': {
+                    if (m_text.compare(m_pos, 2, "?:") == 0) {
+                        m_pos += 2;
+                    }
+                    auto ret = this->parse_alt();
+                    if (this->at_end() || this->peek() != ')') {
+                        this->fail("missing )");
+                    }
+                    ++ m_pos;
+                    return ret;
+                }
+                case ')':
+                    this->fail("unmatched )");
+                case '[':
+                    return this->parse_class();
+                case '.': {
+                    std::bitset<256> chars;
+                    chars.set();
+                    chars.reset('\n');
+                    return make_chars(chars);
+                }
+                case '\\':
+                    return make_chars(this->parse_escape());
+                case '*': case '+': case '?': case '{':
+                    this->fail(std::string("nothing to repeat before ") + c);
+                case '^': case '$':
+                    this->fail(std::string(1, c)
+                        + " is only allowed at the ends of a pattern");
+                }
+                return make_chars(get_byte_set(c));
+            }
+
+            int parse_count()
+            {
+                size_t start = m_pos;
+                int ret = 0;
+                while (!this->at_end() && this->peek() >= '0'
+                && this->peek() <= '9') {
+                    ret = ret * 10 + (m_text[m_pos++] - '0');
+                    if (ret > PATTERN_MAX_REPEAT) {
+                        this->fail("repetition count is too large");
+                    }
+                }
+                if (m_pos == start) {
+                    this->fail("expected a number in {}");
+                }
+                return ret;
+            }
+
+            NodePtr parse_repeat()
+            {
+                auto atom = this->parse_atom();
+                while (!this->at_end()) {
+                    int min, max;
+                    char c = this->peek();
+                    if (c == '*') {
+                        min = 0; max = -1;
+                    } else if (c == '+') {
+                        min = 1; max = -1;
+                    } else if (c == '?') {
+                        min = 0; max = 1;
+                    } else if (c == '{') {
+                        ++ m_pos;
+                        min = this->parse_count();
+                        max = min;
+                        if (!this->at_end() && this->peek() == ',') {
+                            ++ m_pos;
+                            max = -1;
+                            if (!this->at_end() && this->peek() != '}') {
+                                max = this->parse_count();
+                            }
+                        }
+                        if (this->at_end() || this->peek() != '}') {
+                            this->fail("missing }");
+                        }
+                        if (max != -1 && max < min) {
+                            this->fail("invalid range in {}");
+                        }
+                    } else {
+                        break;
+                    }
+                    ++ m_pos;
+                    NodePtr repeat(new Node(Node::REPEAT));
+                    repeat->min = min;
+                    repeat->max = max;
+                    repeat->children.push_back(std::move(atom));
+                    atom = std::move(repeat);
+                }
+                return atom;
+            }
+
+            NodePtr parse_concat()
+            {
+                NodePtr ret(new Node(Node::CONCAT));
+                while (!this->at_end() && this->peek() != '|'
+                && this->peek() != ')') {
+                    ret->children.push_back(this->parse_repeat());
+                }
+                if (ret->children.empty()) {
+                    return NodePtr(new Node(Node::EMPTY));
+                }
+                return ret;
+            }
+
+            NodePtr parse_alt()
+            {
+                auto first = this->parse_concat();
+                if (this->at_end() || this->peek() != '|') {
+                    return first;
+                }
+                NodePtr ret(new Node(Node::ALT));
+                ret->children.push_back(std::move(first));
+                while (!this->at_end() && this->peek() == '|') {
+                    ++ m_pos;
+                    ret->children.push_back(this->parse_concat());
+                }
+                return ret;
+            }
+        public:
+            Parser(const std::string& text)
+            : m_text(text), m_pos(0), m_end(text.size())
+            {
+                // Every pattern must match the whole text anyway
+                if (m_end > 0 && m_text[0] == '^') {
+                    ++ m_pos;
+                }
+                if (m_end > m_pos && m_text[m_end - 1] == '$') {
+                    size_t backslashes = 0;
+                    while (m_end - 1 - backslashes > m_pos
+                    && m_text[m_end - 2 - backslashes] == '\\') {
+                        ++ backslashes;
+                    }
+                    if (backslashes % 2 == 0) {
+                        -- m_end;
+                    }
+                }
+            }
+
+            NodePtr parse()
+            {
+                auto ret = this->parse_alt();
+                if (!this->at_end()) {
+                    this->fail("unmatched )");
+                }
+                return ret;
+            }
+        };
+    }
+
+    std::string glob_to_regex(const std::string& glob)
+    {
+        std::string ret;
+        for (size_t i = 0; i < glob.size(); ++i) {
+            char c = glob[i];
+            if (c == '*') {
+                ret += ".*";
+            } else if (c == '?') {
+                ret += '.';
+            } else if (c == '[') {
+                // Find the end of the set. A ] right at the start is part of
+                // the set.
+                size_t end = i + 1;
+                if (end < glob.size() && (glob[end] == '!' || glob[end] == '^')) {
+                    ++ end;
+                }
+                if (end < glob.size() && glob[end] == ']') {
+                    ++ end;
+                }
+                while (end < glob.size() && glob[end] != ']') {
+                    end += glob[end] == '\\' ? 2 : 1;
+                }
+                if (end >= glob.size()) {
+                    throw std::invalid_argument("Invalid pattern '" + glob
+                        + "': missing ]");
+                }
+                ret += '[';
+                size_t start = i + 1;
+                if (glob[start] == '!' || glob[start] == '^') {
+                    ret += '^';
+                    ++ start;
+                }
+                ret.append(glob, start, end - start);
+                ret += ']';
+                i = end;
+            } else {
+                if (c == '\\') {
+                    if (i + 1 >= glob.size()) {
+                        throw std::invalid_argument("Invalid pattern '" + glob
+                            + "': trailing backslash");
+                    }
+                    c = glob[++i];
+                }
+                bool is_word = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+                    || (c >= '0' && c <= '9');
+                if (!is_word && std::strchr(".^$|()[]{}*+?\\-", c) && c != 0) {
+                    ret += '\\';
+                }
+                ret += c;
+            }
+        }
+        return ret;
+    }
+
+    PatternSet::PatternSet()
+    : m_dfa(std::make_shared<Dfa>()) {}
+
+    namespace {
+        /// Add a state to the NFA, and return its index.
+        /// Throws std::invalid_argument if the NFA grows too large.
+        template<typename State>
+        int add_state(std::vector<State>& nfa, State state = State())
+        {
+            if (nfa.size() >= PATTERN_MAX_NFA_STATES) {
+                throw std::invalid_argument("too many states");
+            }
+            nfa.push_back(std::move(state));
+            return nfa.size() - 1;
+        }
+
+        /// Compile node into the NFA, so that it continues to out. Returns
+        /// the state where node starts.
+        template<typename State>
+        int compile_node(std::vector<State>& nfa, const Node& node, int out)
+        {
+            switch (node.type) {
+            case Node::CHARS: {
+                State state;
+                state.chars = node.chars;
+                state.next = out;
+                return add_state(nfa, std::move(state));
+            }
+            case Node::CONCAT:
+                for (auto it = node.children.rbegin();
+                    it != node.children.rend(); ++it) {
+                    out = compile_node(nfa, **it, out);
+                }
+                return out;
+            case Node::ALT: {
+                std::vector<int> starts;
+                for (const auto& child : node.children) {
+                    starts.push_back(compile_node(nfa, *child, out));
+                }
+                int start = add_state(nfa);
+                nfa[start].epsilon = std::move(starts);
+                return start;
+            }
+            case Node::REPEAT: {
+                const Node& child = *node.children[0];
+                int start = out;
+                if (node.max == -1) {
+                    // A loop that may run any number of times
+                    int loop = add_state(nfa);
+                    int body = compile_node(nfa, child, loop);
+                    nfa[loop].epsilon = {body, out};
+                    start = loop;
+                } else {
+                    // Each optional copy may skip straight to out
+                    for (int i = node.min; i < node.max; ++i) {
+                        int body = compile_node(nfa, child, start);
+                        start = add_state(nfa);
+                        nfa[start].epsilon = {body, out};
+                    }
+                }
+                for (int i = 0; i < node.min; ++i) {
+                    start = compile_node(nfa, child, start);
+                }
+                return start;
+            }
+            case Node::EMPTY:
+                break;
+            }
+            return out;
+        }
+    }
+
+    void PatternSet::add(const std::string& regex)
+    {
+        auto root = Parser(regex).parse();
+        // Compile into the end of the NFA, and cut it back if the pattern
+        // turns out to be too large
+        size_t size = m_nfa.size();
+        int start;
+        try {
+            int accept = add_state(m_nfa);
+            m_nfa[accept].accept = true;
+            start = compile_node(m_nfa, *root, accept);
+        } catch (const std::invalid_argument&) {
+            m_nfa.resize(size);
+            throw std::invalid_argument("Invalid pattern '" + regex
+                + "': too many states along with the other patterns");
+        } catch (...) {
+            m_nfa.resize(size);
+            throw;
+        }
+        m_starts.push_back(start);
+        m_dfa = std::make_shared<Dfa>();
+    }
+
+    void PatternSet::closure(std::vector<int>& states) const
+    {
+        // Keep only states that consume bytes or accept, since only those
+        // tell sets of states apart.
+        std::vector<bool> seen(m_nfa.size(), false);
+        std::vector<int> stack(states.begin(), states.end());
+        states.clear();
+        while (!stack.empty()) {
+            int state = stack.back();
+            stack.pop_back();
+            if (seen[state]) {
+                continue;
+            }
+            seen[state] = true;
+            const auto& nfa_state = m_nfa[state];
+            if (nfa_state.next >= 0 || nfa_state.accept) {
+                states.push_back(state);
+            }
+            for (int next : nfa_state.epsilon) {
+                stack.push_back(next);
+            }
+        }
+        std::sort(states.begin(), states.end());
+    }
+
+    void PatternSet::build(Dfa& dfa) const
+    {
+        // Split bytes into classes that every state treats the same way
+        dfa.classes.fill(0);
+        dfa.class_count = 1;
+        for (const auto& state : m_nfa) {
+            if (state.next < 0) {
+                continue;
+            }
+            std::map<std::pair<uint16_t, bool>, uint16_t> split;
+            for (int i = 0; i < 256; ++i) {
+                auto key = std::make_pair(dfa.classes[i], state.chars.test(i));
+                auto found = split.emplace(key, split.size());
+                dfa.classes[i] = found.first->second;
+            }
+            dfa.class_count = split.size();
+        }
+        std::vector<int> representatives(dfa.class_count);
+        for (int i = 255; i >= 0; --i) {
+            representatives[dfa.classes[i]] = i;
+        }
+        // Subset construction. State 0 is the empty set.
+        std::map<std::vector<int>, uint32_t> ids;
+        std::vector<std::vector<int>> sets = {{}};
+        ids[{}] = 0;
+        std::vector<int> start = m_starts;
+        this->closure(start);
+        size_t set_sizes = start.size();
+        ids[start] = 1;
+        sets.push_back(start);
+        for (size_t id = 0; id < sets.size(); ++id) {
+            if (sets.size() > PATTERN_MAX_DFA_STATES
+            || set_sizes > PATTERN_MAX_DFA_SETS) {
+                dfa.use_nfa = true;
+                dfa.table.clear();
+                dfa.accepting.clear();
+                return;
+            }
+            bool accepting = false;
+            for (int state : sets[id]) {
+                accepting = accepting || m_nfa[state].accept;
+            }
+            dfa.accepting.push_back(accepting);
+            for (size_t cls = 0; cls < dfa.class_count; ++cls) {
+                std::vector<int> next;
+                for (int state : sets[id]) {
+                    const auto& nfa_state = m_nfa[state];
+                    if (nfa_state.next >= 0
+                    && nfa_state.chars.test(representatives[cls])) {
+                        next.push_back(nfa_state.next);
+                    }
+                }
+                this->closure(next);
+                auto found = ids.emplace(next, sets.size());
+                if (found.second) {
+                    set_sizes += next.size();
+                    sets.push_back(std::move(next));
+                }
+                dfa.table.push_back(found.first->second);
+            }
+        }
+    }
+
+    bool PatternSet::match_nfa(boost::string_view text) const
+    {
+        std::vector<int> states = m_starts;
+        this->closure(states);
+        for (char c : text) {
+            std::vector<int> next;
+            for (int state : states) {
+                const auto& nfa_state = m_nfa[state];
+                if (nfa_state.next >= 0
+                && nfa_state.chars.test(static_cast<unsigned char>(c))) {
+                    next.push_back(nfa_state.next);
+                }
+            }
+            if (next.empty()) {
+                return false;
+            }
+            this->closure(next);
+            states = std::move(next);
+        }
+        for (int state : states) {
+            if (m_nfa[state].accept) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool PatternSet::match(boost::string_view text) const
+    {
+        if (m_starts.empty()) {
+            return false;
+        }
+        Dfa& dfa = *m_dfa;
+        std::call_once(dfa.built, [&]() {
+            this->build(dfa);
+        });
+        if (dfa.use_nfa) {
+            return this->match_nfa(text);
+        }
+        uint32_t state = 1;
+        for (char c : text) {
+            state = dfa.table[state * dfa.class_count
+                + dfa.classes[static_cast<unsigned char>(c)]];
+            if (state == 0) {
+                return false;
+            }
+        }
+        return dfa.accepting[state];
+    }
+
+    bool PatternSet::empty() const
+    {
+        return m_starts.empty();
+    }
+}
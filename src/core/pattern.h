@@ -0,0 +1,78 @@
+#pragma once
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <boost/utility/string_view.hpp>
+
+namespace core {
+    /// Convert a glob pattern into a regular expression for PatternSet.
+    /// * matches any number of characters, ? matches a single character,
+    /// and [abc], [a-z] and [!abc] match a single character from a set.
+    /// A backslash matches the next character literally.
+    /// Throws std::invalid_argument if glob is not valid.
+    std::string glob_to_regex(const std::string& glob);
+
+    /// A set of regular expressions, matched all at once by a single DFA.
+    /// A text matches the set if any expression matches the whole text, so
+    /// that the cost of a match only depends on the length of the text, and
+    /// not on the number of expressions.
+    /// Expressions work on bytes, and support literals, ., character
+    /// classes such as [a-z] and [^0-9], the escapes \d \w \s \D \W \S,
+    /// groups, alternation with |, and the repetitions * + ? {n} {n,} and
+    /// {n,m}. A leading ^ and a trailing $ are allowed, but have no effect.
+    /// Expressions are only parsed as they are added. The DFA is built once,
+    /// right before the first match.
+    class PatternSet {
+        /// A state of the NFA that every expression is compiled into.
+        struct NfaState {
+            /// Bytes that lead to next. Empty for states that only have
+            /// epsilon transitions.
+            std::bitset<256> chars;
+            int next = -1;
+            std::vector<int> epsilon;
+            bool accept = false;
+        };
+        /// The DFA of every expression, built on first use.
+        struct Dfa {
+            std::once_flag built;
+            /// Maps each byte to a class of bytes which are never told
+            /// apart.
+            std::array<uint16_t, 256> classes;
+            size_t class_count = 1;
+            /// Transition table, with class_count entries for each state.
+            /// State 0 rejects everything, and state 1 is the start state.
+            std::vector<uint32_t> table;
+            std::vector<bool> accepting;
+            /// True if the DFA grew too large, in which case the NFA is
+            /// simulated instead.
+            bool use_nfa = false;
+        };
+        std::vector<NfaState> m_nfa;
+        /// Start state of every expression.
+        std::vector<int> m_starts;
+        /// Shared by copies, which have the same expressions. Replaced
+        /// whenever an expression is added.
+        std::shared_ptr<Dfa> m_dfa;
+        void build(Dfa& dfa) const;
+        void closure(std::vector<int>& states) const;
+        bool match_nfa(boost::string_view text) const;
+    public:
+        PatternSet();
+
+        /// Add a regular expression to this set.
+        /// Throws std::invalid_argument if it is not valid, or if the set
+        /// would grow too large.
+        void add(const std::string& regex);
+
+        /// Returns true if any expression matches the whole of text.
+        /// Safe to call from many threads at once.
+        bool match(boost::string_view text) const;
+
+        /// Returns true if this set has no expressions.
+        bool empty() const;
+    };
+}
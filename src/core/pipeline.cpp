@@ -0,0 +1,121 @@
+#include "pipeline.h"
+#include "queue.h"
+#include "uring.h"
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace core {
+    TransferPipeline::TransferPipeline(const TransferOptions& options)
+    : m_options(options)
+    {
+        if (this->m_options.workers == 0) {
+            this->m_options.workers = std::thread::hardware_concurrency();
+        }
+        if (this->m_options.workers == 0) {
+            this->m_options.workers = 1;
+        }
+        if (this->m_options.batch_size == 0) {
+            this->m_options.batch_size = 1;
+        }
+    }
+
+    void TransferPipeline::run(const std::vector<TransferJob>& jobs,
+        bool overwrite, Commit commit, std::vector<ContentHash>* hashes) const
+    {
+        if (jobs.empty()) {
+            return;
+        }
+        if (hashes) {
+            hashes->assign(jobs.size(), ContentHash());
+        }
+        const auto& options = this->m_options;
+        BoundedQueue<size_t> planned(options.queue_depth);
+        BoundedQueue<size_t> finished(options.queue_depth);
+        std::atomic<bool> failed(false);
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        auto fail = [&](std::exception_ptr e) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) {
+                error = e;
+            }
+            failed = true;
+            planned.close();
+        };
+
+        std::vector<std::thread> threads;
+        std::atomic<unsigned> running(options.workers);
+        bool use_uring = options.engine == ENGINE_URING
+            && options.mode == TRANSFER_COPY && uring_available();
+        if (use_uring) {
+            threads.emplace_back([&]() {
+                try {
+                    UringTransfer(options.queue_depth).run(jobs, overwrite,
+                        failed, [&](size_t index) {
+                            finished.push(index);
+                        }, hashes);
+                } catch (...) {
+                    fail(std::current_exception());
+                }
+                finished.close();
+            });
+        } else {
+            threads.emplace_back([&]() {
+                for (size_t i = 0; i < jobs.size() && !failed; ++i) {
+                    if (!planned.push(i)) {
+                        break;
+                    }
+                }
+                planned.close();
+            });
+            for (unsigned i = 0; i < options.workers; ++i) {
+                threads.emplace_back([&]() {
+                    size_t index;
+                    while (!failed && planned.pop(index)) {
+                        try {
+                            const auto& job = jobs[index];
+                            transfer_file(job.from, job.to, options.mode,
+                                overwrite, hashes ? &(*hashes)[index] : nullptr);
+                        } catch (...) {
+                            fail(std::current_exception());
+                            break;
+                        }
+                        finished.push(index);
+                    }
+                    if (-- running == 0) {
+                        finished.close();
+                    }
+                });
+            }
+        }
+
+        // Commit finished jobs in batches
+        std::vector<size_t> batch;
+        size_t index;
+        try {
+            while (finished.pop(index)) {
+                batch.push_back(index);
+                if (batch.size() >= options.batch_size) {
+                    commit(batch);
+                    batch.clear();
+                }
+            }
+            if (!batch.empty()) {
+                commit(batch);
+            }
+        } catch (...) {
+            fail(std::current_exception());
+            // Keep draining so that no worker blocks on a full queue. Once
+            // commit has failed, it is not called again.
+            while (finished.pop(index)) {}
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
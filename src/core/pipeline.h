@@ -0,0 +1,77 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include "transfer.h"
+
+namespace core {
+    /// Backend that performs transfers.
+    enum engine_t {
+        /// A pool of worker threads, each doing blocking transfers.
+        ENGINE_THREADS = 0,
+        /// A single thread driving io_uring. Only plain copies go through
+        /// io_uring; other modes, and kernels without io_uring, use
+        /// ENGINE_THREADS instead.
+        ENGINE_URING = 1
+    };
+
+    /// What an import does with a file whose contents are identical to an
+    /// image that is already registered under another name.
+    enum duplicate_t {
+        /// Copy it like any other file, but remember which image it
+        /// duplicates.
+        DUPLICATE_COPY = 0,
+        /// Register its name without keeping a copy of it.
+        DUPLICATE_SKIP = 1,
+        /// Replace the copy with a hard link to the image it duplicates.
+        DUPLICATE_LINK = 2
+    };
+
+    /// Options controlling how files are transferred.
+    struct TransferOptions {
+        /// How each file is placed at its destination.
+        transfer_t mode = TRANSFER_COPY;
+        /// Backend that performs transfers.
+        engine_t engine = ENGINE_THREADS;
+        /// Number of transfer workers. 0 uses one per hardware thread.
+        unsigned workers = 0;
+        /// Maximum number of transfers waiting for, or waiting on, workers.
+        /// With ENGINE_URING, this is the number of files kept in flight.
+        size_t queue_depth = 256;
+        /// Maximum number of finished transfers committed at a time.
+        size_t batch_size = 512;
+        /// How imports handle files whose contents are already registered.
+        /// Exports ignore this.
+        duplicate_t duplicates = DUPLICATE_COPY;
+    };
+
+    /// A single file to transfer.
+    struct TransferJob {
+        fs::path from;
+        fs::path to;
+    };
+
+    /// Transfers files in three stages. A producer feeds the planned jobs to
+    /// a pool of workers through a bounded queue, the workers transfer files,
+    /// and finished jobs are handed back in batches to the calling thread,
+    /// which is the only thread that may touch the database.
+    class TransferPipeline {
+        TransferOptions m_options;
+    public:
+        /// Receives the indices of a batch of jobs that have finished.
+        using Commit = std::function<void(const std::vector<size_t>&)>;
+
+        TransferPipeline(const TransferOptions& options);
+
+        /// Transfer every job.
+        /// If hashes is not null, it is resized to match jobs, and the hash
+        /// of each job's contents is stored there before the job is
+        /// committed.
+        /// If a transfer fails, no new transfers are started, every transfer
+        /// that did finish is still committed, and then the error is thrown.
+        /// If commit throws, no new transfers are started either, but
+        /// commit is never called again, so transfers that finish after
+        /// that are left uncommitted before the error is thrown.
+        void run(const std::vector<TransferJob>& jobs, bool overwrite,
+            Commit commit, std::vector<ContentHash>* hashes = nullptr) const;
+    };
+}
@@ -0,0 +1,188 @@
+#include "profile.h"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace core {
+    const std::string default_profile_name = "default";
+    const std::string custom_profile_name = "custom";
+
+    // When checkpoints run in the background, SQLite only checkpoints on
+    // commit once the WAL has grown this many pages, in case the background
+    // checkpoints cannot keep up.
+    const int64_t BACKGROUND_AUTOCHECKPOINT = 16384;
+    // SQLite's own default.
+    const int64_t DEFAULT_AUTOCHECKPOINT = 1000;
+    // How long to wait for the background checkpointer to let go of the
+    // database, in milliseconds.
+    const int64_t PROFILE_BUSY_TIMEOUT = 5000;
+
+    const std::vector<std::pair<std::string, PerformanceProfile>> presets = {
+        // SQLite's defaults.
+        {default_profile_name, {"delete", "full", 0, -2000, "default", 0}},
+        // Every commit is synced, but only the WAL is written while
+        // committing.
+        {"durable", {"wal", "full", 0, -16384, "default", 1000}},
+        // Recent commits may be lost on power failure, but the database is
+        // never corrupted. Best for importing many files at once.
+        {"bulk", {"wal", "normal", 256 * 1024 * 1024, -65536, "memory", 1000}},
+    };
+
+    const std::vector<std::string> profile_keys = {
+        "journal_mode", "synchronous", "mmap_size", "cache_size",
+        "temp_store", "checkpoint_interval"
+    };
+
+    const std::vector<std::string> journal_modes = {
+        "delete", "truncate", "persist", "wal"
+    };
+    const std::vector<std::string> synchronous_modes = {
+        "off", "normal", "full", "extra"
+    };
+    const std::vector<std::string> temp_stores = {
+        "default", "file", "memory"
+    };
+
+    const std::vector<std::pair<std::string, PerformanceProfile>>&
+        get_profile_presets()
+    {
+        return presets;
+    }
+
+    boost::optional<PerformanceProfile> get_profile_preset(
+        const std::string& name)
+    {
+        for (const auto& preset : presets) {
+            if (preset.first == name) {
+                return preset.second;
+            }
+        }
+        return {};
+    }
+
+    const std::vector<std::string>& get_profile_keys()
+    {
+        return profile_keys;
+    }
+
+    std::runtime_error make_profile_key_error(const std::string& key)
+    {
+        return std::runtime_error("No such profile setting '" + key + "'");
+    }
+
+    std::string get_profile_value(const PerformanceProfile& profile,
+        const std::string& key)
+    {
+        if (key == "journal_mode") {
+            return profile.journal_mode;
+        } else if (key == "synchronous") {
+            return profile.synchronous;
+        } else if (key == "mmap_size") {
+            return std::to_string(profile.mmap_size);
+        } else if (key == "cache_size") {
+            return std::to_string(profile.cache_size);
+        } else if (key == "temp_store") {
+            return profile.temp_store;
+        } else if (key == "checkpoint_interval") {
+            return std::to_string(profile.checkpoint_interval);
+        }
+        throw make_profile_key_error(key);
+    }
+
+    std::string parse_profile_choice(const std::string& key,
+        const std::string& value, const std::vector<std::string>& choices)
+    {
+        std::string lower = value;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        if (std::find(choices.begin(), choices.end(), lower) != choices.end()){
+            return lower;
+        }
+        std::stringstream s;
+        s << "Invalid value '" << value << "' for " << key
+          << ". Valid values are";
+        for (const auto& choice : choices) {
+            s << " '" << choice << "'";
+        }
+        throw std::runtime_error(s.str());
+    }
+
+    int64_t parse_profile_integer(const std::string& key,
+        const std::string& value, bool allow_negative)
+    {
+        try {
+            size_t pos;
+            long long ret = std::stoll(value, &pos, 10);
+            if (pos == value.size() && (allow_negative || ret >= 0)) {
+                return ret;
+            }
+        } catch (...) {}
+        throw std::runtime_error("Invalid value '" + value + "' for " + key
+            + ". Expected " + (allow_negative ? "an integer." :
+                "a non-negative integer."));
+    }
+
+    void set_profile_value(PerformanceProfile& profile,
+        const std::string& key, const std::string& value)
+    {
+        if (key == "journal_mode") {
+            profile.journal_mode = parse_profile_choice(key, value,
+                journal_modes);
+        } else if (key == "synchronous") {
+            profile.synchronous = parse_profile_choice(key, value,
+                synchronous_modes);
+        } else if (key == "mmap_size") {
+            profile.mmap_size = parse_profile_integer(key, value, false);
+        } else if (key == "cache_size") {
+            // "2000k" is the same as -2000, which is easier to give on the
+            // command line.
+            if (!value.empty()
+            && (value.back() == 'k' || value.back() == 'K')) {
+                profile.cache_size = -parse_profile_integer(key,
+                    value.substr(0, value.size() - 1), false);
+            } else {
+                profile.cache_size = parse_profile_integer(key, value, true);
+            }
+        } else if (key == "temp_store") {
+            profile.temp_store = parse_profile_choice(key, value,
+                temp_stores);
+        } else if (key == "checkpoint_interval") {
+            profile.checkpoint_interval = parse_profile_integer(key, value,
+                false);
+        } else {
+            throw make_profile_key_error(key);
+        }
+    }
+
+    void apply_profile(database::Database& db,
+        const PerformanceProfile& profile)
+    {
+        // Values were validated when they were set, but they could still
+        // have been edited into the database by hand.
+        PerformanceProfile checked = profile;
+        for (const auto& key : profile_keys) {
+            set_profile_value(checked, key, get_profile_value(profile, key));
+        }
+        db.execute("PRAGMA busy_timeout = "
+            + std::to_string(PROFILE_BUSY_TIMEOUT));
+        // Changing the journal mode fails silently, returning the journal
+        // mode that is still in use.
+        auto stmt = db.prepare("PRAGMA journal_mode = "
+            + checked.journal_mode);
+        stmt.step();
+        if (stmt.column_value<std::string>(1) != checked.journal_mode) {
+            throw std::runtime_error("Could not change journal mode to "
+                + checked.journal_mode);
+        }
+        stmt.reset();
+        db.execute("PRAGMA synchronous = " + checked.synchronous);
+        db.execute("PRAGMA mmap_size = "
+            + std::to_string(checked.mmap_size));
+        db.execute("PRAGMA cache_size = "
+            + std::to_string(checked.cache_size));
+        db.execute("PRAGMA temp_store = " + checked.temp_store);
+        bool background = checked.journal_mode == "wal"
+            && checked.checkpoint_interval > 0;
+        db.execute("PRAGMA wal_autocheckpoint = " + std::to_string(
+            background ? BACKGROUND_AUTOCHECKPOINT : DEFAULT_AUTOCHECKPOINT));
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/optional.hpp>
+#include "db/database.h"
+
+namespace core {
+    /// How a project's database trades durability for speed.
+    /// Each setting maps directly to the SQLite pragma of the same name,
+    /// except for checkpoint_interval.
+    struct PerformanceProfile {
+        /// delete, truncate, persist or wal
+        std::string journal_mode;
+        /// off, normal, full or extra
+        std::string synchronous;
+        /// Bytes of the database to memory map, 0 to disable.
+        int64_t mmap_size;
+        /// Pages to cache, or KiB to cache if negative. When set from a
+        /// string, a value such as "2000k" also means 2000 KiB.
+        int64_t cache_size;
+        /// default, file or memory
+        std::string temp_store;
+        /// Milliseconds between background checkpoints in WAL mode. If 0,
+        /// SQLite checkpoints during commits instead.
+        int64_t checkpoint_interval;
+    };
+
+    /// Name of the profile used by projects that have not chosen one.
+    extern const std::string default_profile_name;
+
+    /// Name used for profiles that do not match any preset.
+    extern const std::string custom_profile_name;
+
+    /// List all preset profiles along with their names.
+    const std::vector<std::pair<std::string, PerformanceProfile>>&
+        get_profile_presets();
+
+    /// Get a preset profile by its name.
+    boost::optional<PerformanceProfile> get_profile_preset(
+        const std::string& name);
+
+    /// List the names of every setting in a profile.
+    const std::vector<std::string>& get_profile_keys();
+
+    /// Get a setting of profile as a string.
+    /// Throws an exception if key is not a valid setting.
+    std::string get_profile_value(const PerformanceProfile& profile,
+        const std::string& key);
+
+    /// Change a setting of profile.
+    /// Throws an exception if key is not a valid setting, or value is not
+    /// valid for that setting.
+    void set_profile_value(PerformanceProfile& profile,
+        const std::string& key, const std::string& value);
+
+    /// Apply a profile to a database connection.
+    /// Throws an exception if the journal mode could not be changed.
+    void apply_profile(database::Database& db,
+        const PerformanceProfile& profile);
+}
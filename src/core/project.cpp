@@ -1,4 +1,14 @@
 #include "project.h"
+#include "schema.h"
+#include "compact.h"
+#include "db/batch.h"
+#include "nameset.h"
+#include "scan.h"
+#include "texname.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <boost/filesystem/fstream.hpp>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
@@ -57,12 +67,20 @@ namespace core {
     , m_path(path)
     , m_database(path / rbrush_folder_name / rbrush_db_name, flags) {}
 
-    Project::Result::Result() : files(0), folders(0), filtered(0) {}
+    Project::Result::Result()
+    : files(0), folders(0), filtered(0), duplicates(0) {}
+
+    Project::CompactResult::CompactResult()
+    : files(0), groups(0), duplicates(0), linked(0), reclaimed(0),
+      unsupported(false) {}
 
     Project Project::connect(const fs::path& path, bool force)
     {
         check_project_is_valid(path);
-        return Project(path, force, SQLITE_OPEN_READWRITE);
+        Project project(path, force, SQLITE_OPEN_READWRITE);
+        project.upgrade();
+        project.apply_profile();
+        return project;
     }
 
     Project Project::create(const fs::path& path, bool force)
@@ -70,27 +88,247 @@ namespace core {
         check_project_can_create(path);
         fs::create_directories(path/rbrush_folder_name);
         Project project(path, force, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
-        auto& db = project.get_database();
-        db.execute(R"(
-            CREATE TABLE IF NOT EXISTS images(
-                name TEXT NOT NULL,
-                alias TEXT
-            )
+        project.upgrade();
+        project.apply_profile();
+        return project;
+    }
+
+    void Project::upgrade()
+    {
+        int applied = core::migrate_project(this->get_database());
+        fs::path version_path = this->get_path()/rbrush_folder_name
+            /rbrush_version_name;
+        if (applied > 0 || !fs::is_regular_file(version_path)) {
+            fs::ofstream file_version(version_path);
+            file_version << core::version;
+        }
+    }
+
+    void Project::apply_profile()
+    {
+        auto profile = this->get_profile();
+        // Only one connection may be open to leave WAL mode
+        m_checkpointer.reset();
+        core::apply_profile(this->get_database(), profile);
+        if (profile.journal_mode == "wal" && profile.checkpoint_interval > 0){
+            m_checkpointer.reset(new database::Checkpointer(
+                this->get_path()/rbrush_folder_name/rbrush_db_name,
+                std::chrono::milliseconds(profile.checkpoint_interval)));
+        }
+    }
+
+    boost::optional<std::string> Project::get_setting(const std::string& key)
+    {
+        auto stmt = this->get_database().prepare(R"(
+            SELECT value FROM settings
+            WHERE key = ?
         )");
-        db.execute(R"(
-            CREATE TABLE IF NOT EXISTS inputfolders(
-                name TEXT NOT NULL UNIQUE
-            )
+        stmt.bind(1, key);
+        if (stmt.step() != SQLITE_ROW) {
+            return {};
+        }
+        return stmt.column_value<std::string>(1);
+    }
+
+    NameIndex& Project::get_name_index()
+    {
+        if (m_names) {
+            return *m_names;
+        }
+        auto& db = this->get_database();
+        auto generation = this->get_setting("images.generation");
+        auto countstmt = db.prepare(R"(
+            SELECT COUNT(*), SUM(LENGTH(CAST(name AS BLOB))) FROM images
         )");
-        db.execute(R"(
-            CREATE TABLE IF NOT EXISTS filters(
-                id INTEGER PRIMARY KEY AUTOINCREMENT,
-                type INTEGER NOT NULL,
-                name TEXT NOT NULL,
-                arg TEXT NOT NULL
-            )
+        countstmt.step();
+        uint64_t count = countstmt.column_value<int64_t>(1);
+        uint64_t size = countstmt.column_value<int64_t>(2);
+        countstmt.reset();
+        fs::path path = this->get_path()/rbrush_folder_name/rbrush_index_name;
+        if (generation) {
+            m_names = NameIndex::open(path, std::stoull(*generation), count);
+        }
+        if (!m_names) {
+            // Missing, or out of date after a crash. Rebuild it from the
+            // database.
+            m_names = NameIndex::create(path, count, size);
+            auto stmt = db.prepare(R"(
+                SELECT name FROM images
+            )");
+            for (const auto& row : stmt.rows<boost::string_view>()) {
+                m_names->insert(std::get<0>(row));
+            }
+            uint64_t next;
+            {
+                auto transaction = db.create_transaction();
+                next = this->next_images_generation();
+            }
+            m_names->commit(next);
+        }
+        return *m_names;
+    }
+
+    ScanTable& Project::get_scan_table()
+    {
+        if (!m_scan_table) {
+            m_scan_table.reset(new ScanTable(this->get_database()));
+        }
+        return *m_scan_table;
+    }
+
+    void Project::register_sql_functions()
+    {
+        this->get_scan_table();
+        if (!m_filter_function) {
+            m_filter_function.reset(
+                new FilterFunction(this->get_database()));
+        }
+        for (filter_t type : {FILTER_INPUT, FILTER_OUTPUT}) {
+            m_filter_function->set_filters(get_ftype_name(type),
+                this->get_filter_set(type));
+        }
+    }
+
+    namespace {
+        /// Statements that sqlite counts as read only, but that would leave
+        /// a transaction open or change which databases are attached.
+        const char* const QUERY_FORBIDDEN_KEYWORDS[] = {
+            "ATTACH", "BEGIN", "COMMIT", "DETACH", "END", "RELEASE",
+            "ROLLBACK", "SAVEPOINT"};
+
+        /// Get the first keyword of an SQL statement in upper case,
+        /// skipping whitespace and comments.
+        std::string get_sql_keyword(const std::string& sql)
+        {
+            size_t i = 0;
+            while (i < sql.size()) {
+                if (std::isspace(static_cast<unsigned char>(sql[i]))) {
+                    ++ i;
+                } else if (sql.compare(i, 2, "--") == 0) {
+                    i = sql.find('\n', i);
+                } else if (sql.compare(i, 2, "/*") == 0) {
+                    i = sql.find("*/", i + 2);
+                    if (i != std::string::npos) {
+                        i += 2;
+                    }
+                } else {
+                    break;
+                }
+            }
+            std::string ret;
+            for (; i < sql.size()
+            && std::isalpha(static_cast<unsigned char>(sql[i])); ++i) {
+                ret += std::toupper(static_cast<unsigned char>(sql[i]));
+            }
+            return ret;
+        }
+    }
+
+    void Project::query(const std::string& sql,
+        const std::function<void(database::Statement&)>& row)
+    {
+        std::string keyword = get_sql_keyword(sql);
+        for (const char* forbidden : QUERY_FORBIDDEN_KEYWORDS) {
+            if (keyword == forbidden) {
+                throw std::invalid_argument("Queries may not use " + keyword
+                    + ", only statements that read the project database");
+            }
+        }
+        auto& db = this->get_database();
+        this->register_sql_functions();
+        auto stmt = db.prepare(sql);
+        if (!sqlite3_stmt_readonly(stmt.stmt_ptr())) {
+            throw std::invalid_argument(
+                "Queries may not change the project database");
+        }
+        // Any folder may be scanned, but headers are only cached for the
+        // folders that imports and exports look at
+        std::vector<fs::path> roots = this->list_input_folders();
+        roots.push_back(this->get_path());
+        auto image_cache = ImageInfoCache::load(db,
+            m_filter_function->needs_image_info()
+                ? roots : std::vector<fs::path>());
+        m_filter_function->set_image_cache(&image_cache);
+        try {
+            while (stmt.step() == SQLITE_ROW) {
+                row(stmt);
+            }
+        } catch (...) {
+            m_filter_function->set_image_cache(nullptr);
+            throw;
+        }
+        m_filter_function->set_image_cache(nullptr);
+        image_cache.save(db);
+    }
+
+    uint64_t Project::next_images_generation()
+    {
+        auto& db = this->get_database();
+        auto stmt = db.prepare(R"(
+            INSERT INTO settings(key, value)
+            VALUES ('images.generation', 1)
+            ON CONFLICT(key) DO UPDATE
+            SET value = CAST(value AS INTEGER) + 1
         )");
-        return project;
+        stmt.finish();
+        return std::stoull(*this->get_setting("images.generation"));
+    }
+
+    std::string Project::get_profile_name()
+    {
+        auto name = this->get_setting("profile");
+        return name ? *name : default_profile_name;
+    }
+
+    PerformanceProfile Project::get_profile()
+    {
+        auto profile = *get_profile_preset(default_profile_name);
+        for (const auto& key : get_profile_keys()) {
+            auto value = this->get_setting("profile." + key);
+            if (value) {
+                set_profile_value(profile, key, *value);
+            }
+        }
+        return profile;
+    }
+
+    void Project::store_profile(const std::string& name,
+        const PerformanceProfile& profile)
+    {
+        auto& db = this->get_database();
+        auto transaction = db.create_transaction();
+        auto stmt = db.prepare(R"(
+            INSERT OR REPLACE INTO settings(key, value)
+            VALUES (?, ?)
+        )");
+        stmt.bind(1, std::string("profile"));
+        stmt.bind(2, name);
+        stmt.finish();
+        for (const auto& key : get_profile_keys()) {
+            stmt.reset();
+            stmt.bind(1, "profile." + key);
+            stmt.bind(2, get_profile_value(profile, key));
+            stmt.finish();
+        }
+    }
+
+    void Project::set_profile(const std::string& name,
+        const PerformanceProfile& profile)
+    {
+        auto previous_name = this->get_profile_name();
+        auto previous = this->get_profile();
+        this->store_profile(name, profile);
+        try {
+            this->apply_profile();
+        } catch (...) {
+            // Put the old profile back, so that the next time the project is
+            // opened it does not fail the same way.
+            this->store_profile(previous_name, previous);
+            try {
+                this->apply_profile();
+            } catch (...) {}
+            throw;
+        }
     }
 
     database::Database& Project::get_database()
@@ -143,10 +381,8 @@ namespace core {
         auto stmt = db.prepare(
             R"(SELECT name FROM inputfolders)"
         );
-        while (!stmt.done()) {
-            if (stmt.step() == SQLITE_ROW) {
-                ret.push_back(stmt.column_value<std::string>(1));
-            }
+        for (const auto& row : stmt.rows<boost::string_view>()) {
+            ret.push_back(std::get<0>(row).to_string());
         }
         return ret;
     }
@@ -158,18 +394,7 @@ namespace core {
 
     bool Project::has_file(const fs::path& path)
     {
-        std::vector<fs::path> ret;
-        auto& db = this->get_database();
-        auto stmt = db.prepare(R"(
-            SELECT * FROM images WHERE name = ?
-        )");
-        stmt.bind(1, path.filename().string());
-        while (!stmt.done()) {
-            if (stmt.step() == SQLITE_ROW) {
-                return true;
-            }
-        }
-        return false;
+        return this->get_name_index().contains(path.filename().string());
     }
 
     bool Project::register_file(const fs::path& path)
@@ -180,74 +405,208 @@ namespace core {
             throw std::runtime_error(s.str());
         }
         auto& db = this->get_database();
-        auto stmt = db.prepare(R"(
-            INSERT INTO images(name)
-            SELECT ?1
-            WHERE NOT EXISTS (
-                SELECT name FROM images WHERE name = ?1
-            )
-        )");
-        stmt.bind(1, path.filename().string());
-        stmt.finish();
-        return sqlite3_changes(db.get_ptr()) == 0;
+        auto& names = this->get_name_index();
+        std::string name = path.filename().string();
+        uint64_t generation;
+        {
+            auto transaction = db.create_transaction();
+            auto texture = get_texture_columns(name);
+            database::BatchWriter insert(db, R"(
+                INSERT OR IGNORE INTO images(name, tex_width, tex_height,
+                    tex_hash, tex_tlut, tex_format, mip)
+                VALUES )", "(?, ?, ?, ?, ?, ?, ?)");
+            insert.add(name, texture.width, texture.height, texture.hash,
+                texture.tlut, texture.format, texture.mip);
+            insert.flush();
+            if (sqlite3_changes(db.get_ptr()) == 0) {
+                return true;
+            }
+            generation = this->next_images_generation();
+        }
+        names.insert(name);
+        names.commit(generation);
+        return false;
     }
 
     std::vector<fs::path> Project::check()
     {
         std::vector<fs::path> ret;
         auto& db = this->get_database();
-        // insert every image into a temporary database
-        // since many values are being inserted at one time, a transaction will
-        // be made to speed up the process.
-        {
-            auto transaction = db.create_transaction();
-            transaction.push(R"(
-                CREATE TEMP TABLE imglist(
-                    name NTEXT NOT NULL)
-                )",
-                R"(DROP TABLE imglist)"
-            );
-            auto insertstmt = db.prepare(R"(
-                INSERT INTO imglist(name)
-                VALUES (?)
-            )");
-            auto fileiter = fs::recursive_directory_iterator(this->get_path());
-            for (const fs::path& file : fileiter) {
-                insertstmt.reset();
-                insertstmt.bind(1, file.filename().string());
-                insertstmt.finish();
-            }
-            // Find all files that are in the table 'images' but not in the
-            // temporary table 'imglist'. Note that it is fine for files to
-            // exist but not be registered.
-            auto findstmt = db.prepare(R"(
-                SELECT images.name FROM images
-                LEFT OUTER JOIN imglist
-                ON images.name = imglist.name
-                WHERE imglist.name IS NULL
+        // Mark every registered file that can still be found in the project
+        // directory. Note that it is fine for files to exist but not be
+        // registered.
+        auto registered = NameSet::from_query(db, R"(
+            SELECT name FROM images
+            WHERE stored
+        )");
+        std::vector<bool> found(registered.size(), false);
+        // Only directories that changed since the last check are read.
+        std::vector<fs::path> roots = {this->get_path()};
+        auto cache = ScanCache::load(db, roots);
+        Scanner scanner;
+        scanner.set_cache(&cache);
+        scanner.scan(roots,
+            [&](const ScanEntry& entry) {
+                return registered.contains(entry.path.filename().string());
+            },
+            [&](ScanEntry&& entry) {
+                found[registered.find(entry.path.filename().string())] = true;
+            });
+        cache.save(db);
+        for (size_t i = 0; i < registered.size(); ++i) {
+            if (!found[i]) {
+                ret.push_back(registered.at(i));
+            }
+        }
+        if (!ret.empty()) {
+            // Duplicates that were skipped have no file of their own, so
+            // they go along with the image that held their contents.
+            NameSet removed;
+            for (const auto& name : ret) {
+                removed.insert(name.string());
+            }
+            auto skipped = db.prepare(R"(
+                SELECT name, alias FROM images
+                WHERE NOT stored
             )");
-            while (SQLITE_ROW == findstmt.step()) {
-                std::string value = findstmt.column_value<std::string>(1);
-                ret.push_back(value);
-            }
-            auto deletestmt = db.prepare(R"(
-                DELETE FROM images
-                WHERE images.name IN (
-                    SELECT images.name FROM images
-                    LEFT OUTER JOIN imglist
-                    ON images.name = imglist.name
-                    WHERE imglist.name IS NULL
-                )
+            for (const auto& row : skipped.rows<boost::string_view,
+                boost::string_view>()) {
+                if (removed.contains(std::get<1>(row))) {
+                    ret.push_back(std::get<0>(row).to_string());
+                }
+            }
+        }
+        if (!ret.empty()) {
+            auto& names = this->get_name_index();
+            uint64_t generation;
+            {
+                auto transaction = db.create_transaction();
+                database::BatchWriter deletes(db, R"(
+                    DELETE FROM images
+                    WHERE name IN ()", "?", ")");
+                for (const auto& name : ret) {
+                    deletes.add(name.string());
+                }
+                deletes.flush();
+                generation = this->next_images_generation();
+            }
+            for (const auto& name : ret) {
+                names.erase(name.string());
+            }
+            names.commit(generation);
+        }
+        return ret;
+    }
+
+    Project::CompactResult Project::compact(transfer_t mode,
+        unsigned threads, bool dry_run)
+    {
+        CompactResult ret;
+        auto& db = this->get_database();
+        std::vector<fs::path> roots = {this->get_path()};
+        std::vector<fs::path> files;
+        auto cache = ScanCache::load(db, roots);
+        auto& scan_table = this->get_scan_table();
+        scan_table.set_cache(&cache);
+        try {
+            // Temporary files are left behind if an earlier compaction was
+            // interrupted
+            auto stmt = db.prepare(R"(
+                SELECT path FROM rb_scan(?1)
+                WHERE name NOT GLOB '*' || ?2
             )");
-            deletestmt.finish();
+            stmt.bind(1, this->get_path().string());
+            stmt.bind(2, COMPACT_TEMP_SUFFIX);
+            for (const auto& row : stmt.rows<std::string>()) {
+                files.emplace_back(std::get<0>(row));
+            }
+        } catch (...) {
+            scan_table.set_cache(nullptr);
+            throw;
         }
+        scan_table.set_cache(nullptr);
+        ret.files = files.size();
+        auto groups = find_identical_files(files, threads);
+
+        // Files that were linked by an earlier compaction, and have not
+        // changed since, do not need to be linked again.
+        struct Record {
+            std::string source;
+            uint64_t inode;
+            int64_t mtime;
+        };
+        std::unordered_map<std::string, Record> records;
+        auto stmt = db.prepare(R"(
+            SELECT path, source, inode, mtime FROM compacted
+        )");
+        for (const auto& row : stmt.rows<std::string, std::string, int64_t,
+            int64_t>()) {
+            records.emplace(std::get<0>(row), Record {std::get<1>(row),
+                static_cast<uint64_t>(std::get<2>(row)), std::get<3>(row)});
+        }
+
+        // Files that share the data of their source, to be recorded
+        std::vector<std::pair<const FileGroup*, size_t>> shared;
+        for (auto& group : groups) {
+            ++ ret.groups;
+            const fs::path& source = group.paths.front();
+            for (size_t i = 1; i < group.paths.size(); ++i) {
+                ++ ret.duplicates;
+                auto& stat = group.stats[i];
+                if (stat.is_same_file(group.stats.front())) {
+                    shared.emplace_back(&group, i);
+                    continue;
+                }
+                auto iter = records.find(group.paths[i].string());
+                if (iter != records.end()
+                && iter->second.source == source.string()
+                && iter->second.inode == stat.inode
+                && iter->second.mtime == stat.mtime) {
+                    shared.emplace_back(&group, i);
+                    continue;
+                }
+                if (dry_run) {
+                    ret.reclaimed += stat.size;
+                    continue;
+                }
+                if (ret.unsupported) {
+                    continue;
+                }
+                if (!share_file_data(source, group.paths[i], mode)) {
+                    ret.unsupported = true;
+                    continue;
+                }
+                stat = get_file_stat(group.paths[i]);
+                shared.emplace_back(&group, i);
+                ++ ret.linked;
+                ret.reclaimed += stat.size;
+            }
+        }
+        if (dry_run) {
+            return ret;
+        }
+        cache.save(db);
+
+        auto transaction = db.create_transaction();
+        db.execute("DELETE FROM compacted");
+        database::BatchWriter inserts(db, R"(
+            INSERT INTO compacted(path, source, size, hash, inode, mtime)
+            VALUES )", "(?, ?, ?, ?, ?, ?)");
+        for (const auto& pair : shared) {
+            const auto& group = *pair.first;
+            const auto& stat = group.stats[pair.second];
+            inserts.add(group.paths[pair.second].string(),
+                group.paths.front().string(),
+                static_cast<int64_t>(group.hash.size),
+                static_cast<int64_t>(group.hash.hash),
+                static_cast<int64_t>(stat.inode), stat.mtime);
+        }
+        inserts.flush();
         return ret;
     }
 
-    Project::Result Project::import(fs::path export_folder,
-        boost::optional<fs::path> import_folder)
+    fs::path Project::prepare_import_folder(fs::path export_folder)
     {
-        Result ret;
         // make sure export folder exists
         export_folder = core::resolve_path(export_folder);
         if (!core::is_path_within_path(export_folder, get_path())) {
@@ -255,132 +614,502 @@ namespace core {
                 "within project folder.");
         }
         fs::create_directories(export_folder);
+        return export_folder;
+    }
+
+    int Project::transfer_new_files(const fs::path& export_folder,
+        const std::vector<ScanEntry>& pending, const TransferOptions& options,
+        int& duplicates)
+    {
+        // copy all new files into export_folder, and register them
+        // once they have been copied.
         auto& db = this->get_database();
-        {
-            // Get all filters
-            auto filters = this->get_filters();
-            filters.remove_if([](const auto& filter) {
-                return filter.type != FILTER_INPUT;
-            });
-            // Put all images that can be imported into a table
-            auto folders = this->list_input_folders();
-            auto transaction = db.create_transaction();
-            transaction.push(R"(
-                CREATE TEMP TABLE imglist(
-                    name NTEXT NOT NULL,
-                    path NTEXT NOT NULL
-                ))",
-                R"(DROP TABLE imglist)"
-            );
-            auto insertstmt = db.prepare(R"(
-                INSERT INTO imglist(name, path)
-                VALUES (?1, ?2)
-            )");
-            for (const fs::path& folder : folders) {
-                if (!import_folder || fs::equivalent(*import_folder, folder)) {
-                    ++ ret.folders;
-                    auto fileiter = fs::recursive_directory_iterator(folder);
-                    for (const fs::path& file : fileiter) {
-                        bool should_continue = false;
-                        for (const auto& filter : filters) {
-                            if (filter.filter(folder, file)) {
-                                // Yeah, yeah, I know. I'm building the
-                                // pyramids of Egypt over here. But you know
-                                // what? I just don't care. If it works, and it
-                                // looks alright, it's alright.
-                                should_continue = true;
-                                break;
-                            }
-                        }
-                        if (should_continue) {
-                            ++ ret.filtered;
-                            continue;
+        int ret = 0;
+        std::vector<TransferJob> jobs;
+        jobs.reserve(pending.size());
+        NameSet new_names;
+        for (const auto& entry : pending) {
+            fs::path name = entry.path.filename();
+            jobs.push_back(TransferJob {entry.path, export_folder/name});
+            new_names.insert(name.string());
+        }
+        // Duplicates that are skipped or linked must be known before
+        // anything is transferred, so that they are never copied. Plain
+        // copies otherwise hash files for free as they are copied, and
+        // other modes do not hash at all.
+        bool hash_first = options.duplicates != DUPLICATE_COPY;
+        bool hashing = hash_first || options.mode == TRANSFER_COPY;
+        std::vector<ContentHash> hashes;
+        if (hash_first) {
+            std::vector<fs::path> sources;
+            sources.reserve(jobs.size());
+            for (const auto& job : jobs) {
+                sources.push_back(job.from);
+            }
+            hashes = hash_files(sources, options.workers);
+        }
+        // The name of the image that each file duplicates, or an empty
+        // string. Duplicates are always resolved in job order, so that the
+        // first file with some contents is the original no matter which
+        // file finished copying first.
+        std::vector<std::string> originals(jobs.size());
+        // Files of this import that hold their own contents, by hash
+        std::unordered_map<uint64_t, size_t> firsts;
+        auto find_original = db.prepare(R"(
+            SELECT name FROM images
+            WHERE hash = ?1 AND size = ?2 AND alias IS NULL
+        )");
+        auto resolve = [&](size_t index) {
+            const auto& hash = hashes[index];
+            auto found = firsts.find(hash.hash);
+            if (found != firsts.end()) {
+                if (hashes[found->second] == hash) {
+                    originals[index] = jobs[found->second].from.filename()
+                        .string();
+                }
+                return;
+            }
+            find_original.reset();
+            find_original.bind(1, static_cast<int64_t>(hash.hash));
+            find_original.bind(2, static_cast<int64_t>(hash.size));
+            for (const auto& row : find_original.rows<std::string>()) {
+                // Files of this import may already be registered
+                if (!new_names.contains(std::get<0>(row))) {
+                    originals[index] = std::get<0>(row);
+                    break;
+                }
+            }
+            if (originals[index].empty()) {
+                firsts.emplace(hash.hash, index);
+            }
+        };
+        // Register a batch of files, with the hashes and originals that are
+        // known so far
+        auto& names = this->get_name_index();
+        auto register_files = [&](const std::vector<size_t>& batch) {
+            uint64_t generation;
+            {
+                auto transaction = db.create_transaction();
+                database::BatchWriter inserts(db, R"(
+                    INSERT INTO images(name, alias, size, hash, stored,
+                        tex_width, tex_height, tex_hash, tex_tlut,
+                        tex_format, mip)
+                    VALUES )", "(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+                auto add_image = [&](const std::string& name,
+                    const auto& alias, const auto& size, const auto& hash,
+                    int stored) {
+                    // Names are parsed once here, so that filters on names
+                    // can be looked up later instead
+                    auto texture = get_texture_columns(name);
+                    inserts.add(name, alias, size, hash, stored,
+                        texture.width, texture.height, texture.hash,
+                        texture.tlut, texture.format, texture.mip);
+                };
+                for (size_t index : batch) {
+                    std::string name = jobs[index].from.filename().string();
+                    if (!hashing) {
+                        add_image(name, nullptr, nullptr, nullptr, 1);
+                        continue;
+                    }
+                    auto size = static_cast<int64_t>(hashes[index].size);
+                    auto hash = static_cast<int64_t>(hashes[index].hash);
+                    const auto& original = originals[index];
+                    if (original.empty()) {
+                        add_image(name, nullptr, size, hash, 1);
+                    } else {
+                        // Skipped duplicates have no file of their own
+                        add_image(name, original, size, hash,
+                            options.duplicates != DUPLICATE_SKIP);
+                    }
+                }
+                inserts.flush();
+                generation = this->next_images_generation();
+            }
+            for (size_t index : batch) {
+                names.insert(jobs[index].from.filename().string());
+            }
+            names.commit(generation);
+            ret += batch.size();
+        };
+
+        if (!hash_first) {
+            // Every file is copied, and duplicates are only recorded, once
+            // all of their hashes are known
+            std::vector<bool> committed(jobs.size(), false);
+            auto record_duplicates = [&]() {
+                if (!hashing) {
+                    return;
+                }
+                auto transaction = db.create_transaction();
+                database::BatchWriter updates(db, R"(
+                    WITH aliases(name, alias) AS (VALUES )", "(?, ?)", R"()
+                    UPDATE images
+                    SET alias = (
+                        SELECT alias FROM aliases
+                        WHERE aliases.name = images.name)
+                    WHERE name IN (SELECT name FROM aliases)
+                )");
+                for (size_t index = 0; index < jobs.size(); ++index) {
+                    if (!committed[index]) {
+                        continue;
+                    }
+                    resolve(index);
+                    if (!originals[index].empty()) {
+                        ++ duplicates;
+                        updates.add(jobs[index].from.filename().string(),
+                            originals[index]);
+                    }
+                }
+                // Only aliases change, so the name index does not
+                updates.flush();
+            };
+            try {
+                TransferPipeline(options).run(jobs, false,
+                    [&](const std::vector<size_t>& batch) {
+                        register_files(batch);
+                        for (size_t index : batch) {
+                            committed[index] = true;
                         }
-                        insertstmt.reset();
-                        insertstmt.bind(1, file.filename().string());
-                        insertstmt.bind(2, file.string());
-                        insertstmt.finish();
+                    }, hashing ? &hashes : nullptr);
+            } catch (...) {
+                record_duplicates();
+                throw;
+            }
+            record_duplicates();
+            return ret;
+        }
+
+        // Only files that hold their own contents go through the pipeline,
+        // along with duplicates whose original can not be linked to
+        std::vector<size_t> copies;
+        // Duplicates, along with the file that they are linked to
+        std::vector<std::pair<size_t, fs::path>> links;
+        std::vector<size_t> skipped;
+        std::vector<std::string> missing;
+        for (size_t index = 0; index < jobs.size(); ++index) {
+            resolve(index);
+            if (originals[index].empty()) {
+                copies.push_back(index);
+            } else if (options.duplicates == DUPLICATE_SKIP) {
+                skipped.push_back(index);
+            } else if (!new_names.contains(originals[index])) {
+                missing.push_back(originals[index]);
+            }
+        }
+        if (options.duplicates == DUPLICATE_LINK) {
+            // Originals from earlier imports have to be found first
+            auto found = this->find_images(missing);
+            // Files that hold their own contents in place of an original
+            // that is gone, by the name of that original
+            std::unordered_map<std::string, size_t> replacements;
+            for (size_t index = 0; index < jobs.size(); ++index) {
+                auto& original = originals[index];
+                if (original.empty()) {
+                    continue;
+                }
+                if (!new_names.contains(original) && !found.count(original)) {
+                    // The original is gone, so the first file with its
+                    // contents is copied, and becomes an original itself
+                    auto inserted = replacements.emplace(original, index);
+                    if (inserted.second) {
+                        original.clear();
+                        copies.push_back(index);
+                        continue;
                     }
+                    original = jobs[inserted.first->second].from.filename()
+                        .string();
+                }
+                if (new_names.contains(original)) {
+                    links.emplace_back(index, export_folder/original);
+                } else {
+                    links.emplace_back(index, found.at(original));
                 }
             }
-            // find all files that exist in imglist but not in images, insert
-            // those files into images, and copy the files into export_folder.
-            auto selectstmt = db.prepare(R"(
-                SELECT imglist.name, imglist.path FROM imglist
-                LEFT OUTER JOIN images
-                ON imglist.name = images.name
-                WHERE images.name IS NULL
-            )");
-            auto insertfilestmt = db.prepare(R"(
-                INSERT INTO images(name)
-                VALUES (?)
-            )");
-            while (SQLITE_ROW == selectstmt.step()) {
-                ++ ret.files;
-                fs::path name = selectstmt.column_value<std::string>(1);
-                fs::path path = selectstmt.column_value<std::string>(2);
-                fs::path outfile = export_folder/name;
-                fs::copy_file(path, outfile);
-                insertfilestmt.reset();
-                insertfilestmt.bind(1, name.string());
-                insertfilestmt.finish();
+        }
+        duplicates += jobs.size() - copies.size();
+        std::vector<TransferJob> copy_jobs;
+        copy_jobs.reserve(copies.size());
+        for (size_t index : copies) {
+            copy_jobs.push_back(jobs[index]);
+        }
+        TransferPipeline(options).run(copy_jobs, false,
+            [&](const std::vector<size_t>& batch) {
+                std::vector<size_t> indices;
+                indices.reserve(batch.size());
+                for (size_t copy : batch) {
+                    indices.push_back(copies[copy]);
+                }
+                register_files(indices);
+            });
+        std::vector<size_t> linked;
+        for (const auto& link : links) {
+            transfer_file(link.second, jobs[link.first].to,
+                TRANSFER_HARDLINK, false);
+            linked.push_back(link.first);
+        }
+        for (auto batch : {skipped, linked}) {
+            if (!batch.empty()) {
+                register_files(batch);
             }
         }
         return ret;
     }
 
-    Project::Result Project::export_to_folder(fs::path export_folder)
+    std::unordered_map<std::string, fs::path> Project::find_images(
+        const std::vector<std::string>& names)
     {
-        Result ret;
+        std::unordered_map<std::string, fs::path> ret;
+        if (names.empty()) {
+            return ret;
+        }
+        NameSet wanted;
+        for (const auto& name : names) {
+            wanted.insert(name);
+        }
+        // As with imports, the first path in order wins
+        std::vector<ScanEntry> paths(wanted.size());
+        std::vector<bool> found(wanted.size(), false);
         auto& db = this->get_database();
-        auto transaction = db.create_transaction();
+        std::vector<fs::path> roots = {this->get_path()};
+        auto cache = ScanCache::load(db, roots);
+        Scanner scanner;
+        scanner.set_cache(&cache);
+        scanner.scan(roots,
+            [&](const ScanEntry& entry) {
+                return wanted.contains(entry.path.filename().string());
+            },
+            [&](ScanEntry&& entry) {
+                size_t index = wanted.find(entry.path.filename().string());
+                if (!found[index] || entry < paths[index]) {
+                    paths[index] = std::move(entry);
+                    found[index] = true;
+                }
+            });
+        cache.save(db);
+        for (size_t i = 0; i < wanted.size(); ++i) {
+            if (found[i]) {
+                ret.emplace(wanted.at(i), paths[i].path);
+            }
+        }
+        return ret;
+    }
 
-        auto filters = this->get_filters();
-        filters.remove_if([](const auto& filter) {
-            return filter.type != FILTER_OUTPUT;
+    Project::Result Project::import(fs::path export_folder,
+        boost::optional<fs::path> import_folder,
+        const TransferOptions& options)
+    {
+        Result ret;
+        export_folder = this->prepare_import_folder(export_folder);
+        auto& db = this->get_database();
+        // Get all filters
+        auto filters = this->get_filter_set(FILTER_INPUT);
+        // Find all files that are not yet registered. When several input
+        // files share a name, only the first one in (folder, path) order
+        // is imported, so that the outcome does not depend on the order
+        // in which the scanner found them.
+        const auto& known = this->get_name_index();
+        std::vector<fs::path> roots;
+        for (const fs::path& folder : this->list_input_folders()) {
+            if (!import_folder || fs::equivalent(*import_folder, folder)) {
+                ++ ret.folders;
+                roots.push_back(folder);
+            }
+        }
+        // Directories that have not changed since the last import do not
+        // need to be read again.
+        auto cache = ScanCache::load(db, roots);
+        Scanner scanner;
+        scanner.set_cache(&cache);
+        // Folders that are filtered out as a whole are never read.
+        scanner.set_prune([&](size_t root, const fs::path& path) {
+            return filters.prune(roots[root], path);
         });
+        // Image headers are only read again for images that changed.
+        auto image_cache = ImageInfoCache::load(db,
+            filters.needs_image_info() ? roots : std::vector<fs::path>());
+        filters.set_image_cache(&image_cache);
+        std::atomic<int> filtered(0);
+        NameSet candidates;
+        std::vector<ScanEntry> pending;
+        scanner.scan(roots,
+            [&](const ScanEntry& entry) {
+                if (filters.filter(roots[entry.root], entry.path)) {
+                    ++ filtered;
+                    return false;
+                }
+                return !known.contains(entry.path.filename().string());
+            },
+            [&](ScanEntry&& entry) {
+                auto inserted = candidates.insert(
+                    entry.path.filename().string());
+                if (inserted.second) {
+                    pending.push_back(std::move(entry));
+                } else if (entry < pending[inserted.first]) {
+                    pending[inserted.first] = std::move(entry);
+                }
+            });
+        ret.filtered = filtered;
+        cache.save(db);
+        image_cache.save(db);
+        std::sort(pending.begin(), pending.end());
+        ret.files = this->transfer_new_files(export_folder, pending, options,
+            ret.duplicates);
+        return ret;
+    }
 
-        // Create a temporary table that is a list of files in the project
-        transaction.push(R"(
-            CREATE TEMP TABLE imglist(
-                name NTEXT NOT NULL,
-                path NTEXT NOT NULL)
-            )",
-            R"(DROP TABLE imglist)"
-        );
-        auto insertstmt = db.prepare(R"(
-            INSERT INTO imglist(name, path)
-            VALUES (?, ?)
+    Project::Result Project::import_files(fs::path export_folder,
+        const std::vector<fs::path>& roots, std::vector<ScanEntry> files,
+        const TransferOptions& options)
+    {
+        Result ret;
+        ret.folders = roots.size();
+        export_folder = this->prepare_import_folder(export_folder);
+        auto& db = this->get_database();
+        auto filters = this->get_filter_set(FILTER_INPUT);
+        auto image_cache = ImageInfoCache::load(db,
+            filters.needs_image_info() ? roots : std::vector<fs::path>());
+        filters.set_image_cache(&image_cache);
+        // Same rules as Project::import, but since only a few files are
+        // expected, each one is looked up in the database instead.
+        std::sort(files.begin(), files.end());
+        NameSet candidates;
+        std::vector<ScanEntry> pending;
+        for (auto& entry : files) {
+            if (!fs::is_regular_file(entry.path)) {
+                // Removed again before it could be imported
+                continue;
+            }
+            if (filters.filter(roots.at(entry.root), entry.path)) {
+                ++ ret.filtered;
+                continue;
+            }
+            if (candidates.insert(entry.path.filename().string()).second
+            && !this->has_file(entry.path)) {
+                pending.push_back(std::move(entry));
+            }
+        }
+        image_cache.save(db);
+        ret.files = this->transfer_new_files(export_folder, pending, options,
+            ret.duplicates);
+        return ret;
+    }
+
+    Project::Result Project::export_to_folder(fs::path export_folder,
+        const TransferOptions& options)
+    {
+        Result ret;
+        auto& db = this->get_database();
+
+        auto filters = this->get_filter_set(FILTER_OUTPUT);
+        std::vector<fs::path> roots = {this->get_path()};
+        auto image_cache = ImageInfoCache::load(db,
+            filters.needs_image_info() ? roots : std::vector<fs::path>());
+        filters.set_image_cache(&image_cache);
+
+        // Only one file is exported for each name. As with import, the
+        // first file in path order wins.
+        auto registered = NameSet::from_query(db, R"(
+            SELECT name FROM images
         )");
-        auto fileiter = fs::recursive_directory_iterator(this->get_path());
-        for (const fs::path& file : fileiter) {
-            insertstmt.reset();
-            insertstmt.bind(1, file.filename().string());
-            insertstmt.bind(2, file.string());
-            insertstmt.finish();
+        // Rules about names were applied to every name as it was
+        // registered, so names that they filter out are found through the
+        // indexes of the images table.
+        NameSet excluded;
+        std::string query = filters.texture_query();
+        if (!query.empty()) {
+            excluded = NameSet::from_query(db, query);
+            filters.remove_texture_rules();
         }
-        auto selectstmt = db.prepare(R"(
-            SELECT imglist.name, imglist.path FROM images
-            INNER JOIN imglist ON images.name = imglist.name
+        std::atomic<int> filtered(0);
+        NameSet names;
+        std::vector<ScanEntry> selected;
+        Scanner scanner;
+        scanner.set_prune([&](size_t, const fs::path& path) {
+            return filters.prune(this->get_path(), path);
+        });
+        scanner.scan(roots,
+            [&](const ScanEntry& entry) {
+                std::string name = entry.path.filename().string();
+                if (!registered.contains(name)) {
+                    return false;
+                }
+                if (excluded.contains(name)
+                || filters.filter(this->get_path(), entry.path)) {
+                    ++ filtered;
+                    return false;
+                }
+                return true;
+            },
+            [&](ScanEntry&& entry) {
+                auto inserted = names.insert(entry.path.filename().string());
+                if (inserted.second) {
+                    selected.push_back(std::move(entry));
+                } else if (entry < selected[inserted.first]) {
+                    selected[inserted.first] = std::move(entry);
+                }
+            });
+        ret.filtered = filtered;
+        std::sort(selected.begin(), selected.end());
+        std::vector<TransferJob> jobs;
+        jobs.reserve(selected.size());
+        for (const auto& entry : selected) {
+            jobs.push_back(TransferJob {
+                entry.path, export_folder/entry.path.filename()});
+        }
+        // Skipped duplicates have no file of their own, so they are
+        // exported from the file of the image that they duplicate.
+        std::vector<std::pair<std::string, std::string>> skipped;
+        std::unordered_map<std::string, fs::path> originals;
+        auto skipstmt = db.prepare(R"(
+            SELECT name, alias FROM images
+            WHERE stored = 0 AND alias IS NOT NULL
         )");
-        while (selectstmt.step() == SQLITE_ROW) {
-            std::string name = selectstmt.column_value<std::string>(1);
-            fs::path path = selectstmt.column_value<std::string>(2);
-            bool should_copy = true;
-            for (const auto& filter : filters) {
-                if (filter.filter(this->get_path(), path)) {
-                    should_copy = false;
-                    break;
+        for (const auto& row : skipstmt.rows<std::string, std::string>()) {
+            if (!names.contains(std::get<0>(row))) {
+                originals.emplace(std::get<1>(row), fs::path());
+                skipped.emplace_back(std::get<0>(row), std::get<1>(row));
+            }
+        }
+        if (!skipped.empty()) {
+            for (const auto& entry : selected) {
+                auto found = originals.find(entry.path.filename().string());
+                if (found != originals.end()) {
+                    found->second = entry.path;
                 }
             }
-            if (should_copy) {
-                fs::copy_file(path, export_folder/name,
-                    fs::copy_option::overwrite_if_exists);
-                ++ ret.files;
-            } else {
+            // Originals that were filtered out still have a file
+            std::vector<std::string> missing;
+            for (const auto& pair : originals) {
+                if (pair.second.empty()) {
+                    missing.push_back(pair.first);
+                }
+            }
+            for (auto& pair : this->find_images(missing)) {
+                originals[pair.first] = std::move(pair.second);
+            }
+        }
+        for (const auto& pair : skipped) {
+            const fs::path& original = originals[pair.second];
+            if (original.empty()) {
+                // The original is gone as well
+                continue;
+            }
+            // Rules about names and folders look at the duplicate, which
+            // has no file to read, and rules about images look at the file
+            // that it shares its contents with
+            if (excluded.contains(pair.first) || filters.filter(
+                this->get_path(), original.parent_path()/pair.first)
+            || filters.match_image(original)) {
                 ++ ret.filtered;
+                continue;
             }
+            jobs.push_back(TransferJob {original, export_folder/pair.first});
         }
+        image_cache.save(db);
+        TransferPipeline(options).run(jobs, true,
+            [&](const std::vector<size_t>& batch) {
+                ret.files += batch.size();
+            });
         ++ ret.folders;
         return ret;
     }
@@ -407,21 +1136,29 @@ namespace core {
             SELECT id, type, name, arg
             FROM filters
         )");
-        while (SQLITE_ROW == selectstmt.step()) {
-            int id = selectstmt.column_value<int>(1);
-            int type = selectstmt.column_value<int>(2);
-            std::string name = selectstmt.column_value<std::string>(3);
-            std::string arg = selectstmt.column_value<std::string>(4);
+        for (const auto& row : selectstmt.rows<int, int, std::string,
+            std::string>()) {
             ret.push_back(Project::FilterData {
-                factory.create(name, arg),
-                static_cast<filter_t>(type),
-                id
+                factory.create(std::get<2>(row), std::get<3>(row)),
+                static_cast<filter_t>(std::get<1>(row)),
+                std::get<0>(row)
             });
         }
 
         return ret;
     }
 
+    FilterSet Project::get_filter_set(filter_t type)
+    {
+        FilterSet ret;
+        for (auto& data : this->get_filters()) {
+            if (data.type == type) {
+                ret.add(std::move(data.filter));
+            }
+        }
+        return ret;
+    }
+
     bool Project::remove_filter(int id)
     {
         auto& db = this->get_database();
@@ -434,9 +1171,13 @@ namespace core {
         return sqlite3_changes(db.get_ptr()) == 0;
     }
 
-    boost::optional<Project> open_project(const fs::path& path, bool force)
+    boost::optional<Project> open_project(const fs::path& path, bool force,
+        bool check)
     {
         core::Project project = core::Project::connect(path, force);
+        if (!check) {
+            return project;
+        }
         auto removedpaths = project.check();
         if (removedpaths.size() > 0) {
             std::cout << "Warning: the following files were removed since "
@@ -451,13 +1192,13 @@ namespace core {
         return project;
     }
 
-    boost::optional<Project> get_project(bool force)
+    boost::optional<Project> get_project(bool force, bool check)
     {
         auto path = core::get_project_directory(fs::current_path());
         if (!path) {
             std::cout << "Could not find repaintbrush project folder." << std::endl;
             return {};
         }
-        return open_project(*path, force);
+        return open_project(*path, force, check);
     }
 }
@@ -1,17 +1,70 @@
 #pragma once
+#include <functional>
 #include <memory>
+#include <unordered_map>
 #include <sqlite3.h>
 #include "util.h"
 #include "db/database.h"
+#include "db/checkpoint.h"
 #include "filter.h"
+#include "filterfunction.h"
+#include "nameindex.h"
+#include "pipeline.h"
+#include "profile.h"
+#include "scan.h"
+#include "scantable.h"
 
 namespace core {
     class Project {
         ProjectFolderLock m_lock;
         fs::path m_path;
         database::Database m_database;
+        std::unique_ptr<database::Checkpointer> m_checkpointer;
+        std::unique_ptr<NameIndex> m_names;
+        // Declared after m_database, so that rb_scan and rb_filtered are
+        // dropped before the connection is closed.
+        std::unique_ptr<ScanTable> m_scan_table;
+        std::unique_ptr<FilterFunction> m_filter_function;
         Project(const fs::path& path,
             bool force, int flags);
+        /// Upgrade this project's database to the current schema.
+        void upgrade();
+        /// Apply the stored performance profile to the database, and start
+        /// or stop background checkpoints to match it.
+        void apply_profile();
+        /// Get a value from the settings table.
+        boost::optional<std::string> get_setting(const std::string& key);
+        /// Get the index of registered names, opening or rebuilding it on
+        /// first use.
+        NameIndex& get_name_index();
+        /// Get the rb_scan function of the database, registering it on
+        /// first use.
+        ScanTable& get_scan_table();
+        /// Advance the generation of the images table, and return the new
+        /// generation. Call this in the same transaction as every change to
+        /// the images table, and then commit the same changes to the name
+        /// index with the returned generation.
+        uint64_t next_images_generation();
+        /// Write a performance profile into the settings table.
+        void store_profile(const std::string& name,
+            const PerformanceProfile& profile);
+        /// Resolve the folder that files are imported into, and make sure
+        /// that it exists and is inside of the project.
+        fs::path prepare_import_folder(fs::path export_folder);
+        /// Transfer files into export_folder and register them, along with
+        /// the hashes of their contents. Files whose contents are already
+        /// registered are handled as options.duplicates says. When several
+        /// files share contents, the earliest of them in pending is the
+        /// original.
+        /// Returns the number of files that were imported, and adds the
+        /// number of them that were duplicates to duplicates.
+        int transfer_new_files(const fs::path& export_folder,
+            const std::vector<ScanEntry>& pending,
+            const TransferOptions& options, int& duplicates);
+        /// Find the current path of each registered name inside of the
+        /// project folder. Names that can not be found are left out.
+        std::unordered_map<std::string, fs::path> find_images(
+            const std::vector<std::string>& names);
     public:
         /// Type defining a type of a filter
         enum filter_t {
@@ -30,6 +83,25 @@ namespace core {
             int files;
             int folders;
             int filtered;
+            /// Imported files whose contents were already registered.
+            int duplicates;
+        };
+
+        struct CompactResult {
+            CompactResult();
+            /// Files in the project folder.
+            int files;
+            /// Sets of files with identical contents.
+            int groups;
+            /// Files that have the same contents as another file.
+            int duplicates;
+            /// Duplicates that were made to share data by this compaction.
+            int linked;
+            /// Bytes that are no longer stored more than once.
+            uint64_t reclaimed;
+            /// True if the file system could not share data, in which case
+            /// compaction stopped early.
+            bool unsupported;
         };
 
         // May move a project
@@ -50,6 +122,23 @@ namespace core {
         /// Get a reference to this project's underlying database
         database::Database& get_database();
 
+        /// Register rb_scan and rb_filtered on this project's database, so
+        /// that queries can scan folders and apply filters. rb_filtered
+        /// gets the project's current filters, with the kinds "input" and
+        /// "output"; call this again after filters change. No image cache
+        /// is attached, so rules about image headers read every file they
+        /// are asked about. See ScanTable and FilterFunction.
+        void register_sql_functions();
+
+        /// Run a single SQL statement that does not change the database,
+        /// with rb_scan and rb_filtered registered, and call row for every
+        /// row of its result. Image headers are cached as they are for
+        /// imports. Throws std::invalid_argument if the statement could
+        /// change the database, controls transactions, or attaches or
+        /// detaches a database.
+        void query(const std::string& sql,
+            const std::function<void(database::Statement&)>& row);
+
         /// Add a folder to input folders
         /// Returns true if the folder already exists.
         bool add_inputfolder(const fs::path& path);
@@ -75,19 +164,62 @@ namespace core {
 
         /// Checks registered files.
         /// Checks all files in the project directory with registered files,
-        /// and remove registered files that no longer exist.
+        /// and remove registered files that no longer exist, along with
+        /// duplicates of them that were skipped on import. Directories
+        /// that have not changed since the last check are not read again.
         /// Returns a list of all files that were removed.
         std::vector<fs::path> check();
 
+        /// Make identical files in the project folder share their data.
+        /// Every file is hashed by a pool of threads, and files with
+        /// identical contents are grouped. Within a group, every file but
+        /// the first one in path order is replaced by a reflink to it, or by
+        /// a hard link if mode is TRANSFER_HARDLINK. Files keep their names,
+        /// so exports produce exactly the same files as before. The groups
+        /// are recorded in the database. If dry_run is true, files are only
+        /// grouped, and neither the files nor the database are changed.
+        CompactResult compact(transfer_t mode = TRANSFER_REFLINK,
+            unsigned threads = 0, bool dry_run = false);
+
         /// Import files into export_folder.
         /// Be sure to check that export_folder is a relative path to the base path.
         /// The optional argument import_folder specifies that only that folder
-        /// should be imported.
+        /// should be imported. options controls how files are placed into
+        /// export_folder. Imported files are registered in batches as they
+        /// finish copying.
         Result import(fs::path export_folder,
-            boost::optional<fs::path> import_folder);
+            boost::optional<fs::path> import_folder,
+            const TransferOptions& options = TransferOptions());
+
+        /// Import a given list of files into export_folder.
+        /// Each file's root is an index into roots, which are the input
+        /// folders that the files were found in. Files are filtered and
+        /// checked against registered files the same way as with
+        /// Project::import. This is meant for small batches of files, such as
+        /// those reported by a Watcher.
+        Result import_files(fs::path export_folder,
+            const std::vector<fs::path>& roots, std::vector<ScanEntry> files,
+            const TransferOptions& options = TransferOptions());
 
         /// Export all registered files into a given folder.
-        Result export_to_folder(fs::path export_folder);
+        /// options controls how files are placed into export_folder.
+        /// Duplicates that were skipped on import are exported under their
+        /// own names, from the file of the image that they duplicate.
+        Result export_to_folder(fs::path export_folder,
+            const TransferOptions& options = TransferOptions());
+
+        /// Get the name of this project's performance profile. This is either
+        /// the name of a preset, or custom_profile_name.
+        std::string get_profile_name();
+
+        /// Get this project's performance profile.
+        PerformanceProfile get_profile();
+
+        /// Store a new performance profile under name, and apply it.
+        /// Throws an exception if the profile could not be applied, in which
+        /// case the previous profile is kept.
+        void set_profile(const std::string& name,
+            const PerformanceProfile& profile);
 
         /// Add a filter to this project.
         void add_filter(filter_t type, const Filter& filter);
@@ -95,18 +227,26 @@ namespace core {
         /// Get a list of filters
         std::list<FilterData> get_filters();
 
+        /// Get all filters of the given type, compiled into a FilterSet.
+        FilterSet get_filter_set(filter_t type);
+
         /// Remove a filter from this project.
         /// Returns true if filter of id does not exist
         bool remove_filter(int id);
     };
 
-    boost::optional<Project> open_project(const fs::path& path, bool force);
+    /// Open the project at path.
+    /// If check is true, a sanity check is performed after opening the
+    /// project. Commands that never look at registered files may skip it.
+    boost::optional<Project> open_project(const fs::path& path, bool force,
+        bool check = true);
 
     /// Get the project.
     /// Searches the current directory and all parents of the current directory
     /// for a valid project, and return none if a project could not be found.
-    /// This function will perform a sanity check after opening the project.
-    boost::optional<Project> get_project(bool force);
+    /// If check is true, this function will perform a sanity check after
+    /// opening the project.
+    boost::optional<Project> get_project(bool force, bool check = true);
 
     const std::string& get_ftype_name(core::Project::filter_t type);
 }
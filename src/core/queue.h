@@ -0,0 +1,69 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace core {
+    /// A thread safe first-in first-out queue with a maximum size.
+    /// Producers block while the queue is full, and consumers block while it
+    /// is empty. Once a queue is closed, pushing fails and consumers drain
+    /// whatever is left.
+    template<typename T>
+    class BoundedQueue {
+        std::mutex m_mutex;
+        std::condition_variable m_not_empty;
+        std::condition_variable m_not_full;
+        std::deque<T> m_items;
+        size_t m_capacity;
+        bool m_closed;
+    public:
+        BoundedQueue(size_t capacity)
+        : m_capacity(capacity > 0 ? capacity : 1), m_closed(false) {}
+
+        /// Add an item to the queue, waiting for space if necessary.
+        /// Returns false if the queue was closed.
+        bool push(T item)
+        {
+            std::unique_lock<std::mutex> lock(this->m_mutex);
+            this->m_not_full.wait(lock, [this]() {
+                return this->m_closed || this->m_items.size() < this->m_capacity;
+            });
+            if (this->m_closed) {
+                return false;
+            }
+            this->m_items.push_back(std::move(item));
+            lock.unlock();
+            this->m_not_empty.notify_one();
+            return true;
+        }
+
+        /// Take an item from the queue, waiting for one if necessary.
+        /// Returns false if the queue is closed and empty.
+        bool pop(T& item)
+        {
+            std::unique_lock<std::mutex> lock(this->m_mutex);
+            this->m_not_empty.wait(lock, [this]() {
+                return this->m_closed || !this->m_items.empty();
+            });
+            if (this->m_items.empty()) {
+                return false;
+            }
+            item = std::move(this->m_items.front());
+            this->m_items.pop_front();
+            lock.unlock();
+            this->m_not_full.notify_one();
+            return true;
+        }
+
+        /// Close the queue. Waiting producers and consumers are woken up.
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(this->m_mutex);
+                this->m_closed = true;
+            }
+            this->m_not_empty.notify_all();
+            this->m_not_full.notify_all();
+        }
+    };
+}
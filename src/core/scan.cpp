@@ -0,0 +1,296 @@
+#include "scan.h"
+#include "util.h"
+#include "directory.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace core {
+    bool ScanEntry::operator<(const ScanEntry& other) const
+    {
+        if (this->root != other.root) {
+            return this->root < other.root;
+        }
+        return this->path < other.path;
+    }
+
+    // Number of files a worker collects before handing them to the receiver
+    const size_t SCAN_BATCH_SIZE = 256;
+    // How long an idle worker waits before trying to steal work again
+    const std::chrono::microseconds SCAN_IDLE_WAIT(200);
+
+    namespace {
+        /// A directory waiting to be read. Subdirectories are opened
+        /// relative to their parent, which is kept open until all of its
+        /// subdirectories have been opened.
+        struct WorkItem {
+            size_t root;
+            std::shared_ptr<const DirectoryReader> parent;
+            std::string name;
+        };
+
+        /// A worker's own queue of directories.
+        /// The owner takes from the back, while thieves take from the front,
+        /// so that the owner keeps walking depth first while thieves take the
+        /// largest remaining subtrees.
+        struct WorkQueue {
+            std::mutex mutex;
+            std::deque<WorkItem> items;
+        };
+
+        /// State shared by every worker during a single scan.
+        struct ScanState {
+            const std::vector<fs::path>& roots;
+            const Scanner::Accept& accept;
+            const Scanner::Prune& prune;
+            ScanCache* cache;
+            std::vector<std::unique_ptr<WorkQueue>> queues;
+            // Directories that have been queued but not yet fully read
+            std::atomic<size_t> pending;
+            std::atomic<bool> failed;
+            std::exception_ptr error;
+            // Results waiting for the receiver
+            std::mutex result_mutex;
+            std::condition_variable result_cv;
+            std::deque<std::vector<ScanEntry>> results;
+            size_t running;
+
+            ScanState(const std::vector<fs::path>& roots,
+                const Scanner::Accept& accept, const Scanner::Prune& prune,
+                ScanCache* cache)
+            : roots(roots), accept(accept), prune(prune), cache(cache)
+            , pending(0), failed(false), running(0) {}
+
+            void push_work(size_t worker, WorkItem item)
+            {
+                ++ this->pending;
+                auto& queue = *this->queues[worker];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.items.push_back(std::move(item));
+            }
+
+            bool pop_work(size_t worker, WorkItem& item)
+            {
+                {
+                    auto& queue = *this->queues[worker];
+                    std::lock_guard<std::mutex> lock(queue.mutex);
+                    if (!queue.items.empty()) {
+                        item = std::move(queue.items.back());
+                        queue.items.pop_back();
+                        return true;
+                    }
+                }
+                for (size_t i = 1; i < this->queues.size(); ++i) {
+                    auto& queue = *this->queues[(worker + i) % this->queues.size()];
+                    std::lock_guard<std::mutex> lock(queue.mutex);
+                    if (!queue.items.empty()) {
+                        item = std::move(queue.items.front());
+                        queue.items.pop_front();
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            void push_results(std::vector<ScanEntry>& batch)
+            {
+                if (batch.empty()) {
+                    return;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(this->result_mutex);
+                    this->results.push_back(std::move(batch));
+                }
+                this->result_cv.notify_one();
+                batch.clear();
+            }
+
+            void fail(std::exception_ptr e)
+            {
+                std::lock_guard<std::mutex> lock(this->result_mutex);
+                if (!this->failed) {
+                    this->error = e;
+                    this->failed = true;
+                }
+            }
+        };
+
+        void read_subdirectory(ScanState& state, size_t worker,
+            const WorkItem& item, const std::shared_ptr<DirectoryReader>& reader,
+            const char* name)
+        {
+            if (state.prune && state.prune(item.root, reader->get_path()/name)) {
+                return;
+            }
+            state.push_work(worker, WorkItem {item.root, reader, name});
+        }
+
+        void read_file(ScanState& state, const WorkItem& item,
+            const DirectoryReader& reader, const char* name,
+            std::vector<ScanEntry>& batch)
+        {
+            ScanEntry result {item.root, reader.get_path() / name};
+            if (state.accept(result)) {
+                batch.push_back(std::move(result));
+                if (batch.size() >= SCAN_BATCH_SIZE) {
+                    state.push_results(batch);
+                }
+            }
+        }
+
+        void read_directory(ScanState& state, size_t worker,
+            const WorkItem& item, std::vector<ScanEntry>& batch)
+        {
+            std::shared_ptr<DirectoryReader> reader;
+            if (item.parent) {
+                reader = std::make_shared<DirectoryReader>(
+                    *item.parent, item.name.c_str());
+            } else {
+                reader = std::make_shared<DirectoryReader>(item.name);
+            }
+            ScanCache::Entry fresh;
+            if (state.cache) {
+                auto stat = reader->stat();
+                const auto* cached = state.cache->find(
+                    reader->get_path().string());
+                if (cached && cached->inode == stat.inode
+                && cached->mtime == stat.mtime) {
+                    for (const auto& name : cached->dirs) {
+                        read_subdirectory(state, worker, item, reader,
+                            name.c_str());
+                    }
+                    for (const auto& name : cached->files) {
+                        read_file(state, item, *reader, name.c_str(), batch);
+                    }
+                    return;
+                }
+                fresh.inode = stat.inode;
+                fresh.mtime = stat.mtime;
+            }
+            DirectoryReader::Entry entry;
+            while (reader->next(entry)) {
+                if (entry.type == ENTRY_DIRECTORY) {
+                    if (entry.name != rbrush_folder_name) {
+                        read_subdirectory(state, worker, item, reader,
+                            entry.name);
+                        if (state.cache) {
+                            fresh.dirs.push_back(entry.name);
+                        }
+                    }
+                } else if (entry.type == ENTRY_FILE) {
+                    if (state.cache) {
+                        fresh.files.push_back(entry.name);
+                    }
+                    read_file(state, item, *reader, entry.name, batch);
+                }
+            }
+            if (state.cache) {
+                state.cache->update(reader->get_path().string(),
+                    std::move(fresh));
+            }
+        }
+
+        void scan_worker(ScanState& state, size_t worker)
+        {
+            std::vector<ScanEntry> batch;
+            WorkItem item;
+            try {
+                while (!state.failed) {
+                    if (state.pop_work(worker, item)) {
+                        read_directory(state, worker, item, batch);
+                        -- state.pending;
+                    } else if (state.pending == 0) {
+                        break;
+                    } else {
+                        // Another worker is still reading a directory that
+                        // may produce more work.
+                        std::this_thread::sleep_for(SCAN_IDLE_WAIT);
+                    }
+                }
+                state.push_results(batch);
+            } catch (...) {
+                state.fail(std::current_exception());
+            }
+            {
+                std::lock_guard<std::mutex> lock(state.result_mutex);
+                -- state.running;
+            }
+            state.result_cv.notify_one();
+        }
+    }
+
+    Scanner::Scanner(unsigned threads)
+    : m_threads(threads), m_cache(nullptr)
+    {
+        if (this->m_threads == 0) {
+            this->m_threads = std::thread::hardware_concurrency();
+        }
+        if (this->m_threads == 0) {
+            this->m_threads = 1;
+        }
+    }
+
+    void Scanner::set_cache(ScanCache* cache)
+    {
+        this->m_cache = cache;
+    }
+
+    void Scanner::set_prune(Prune prune)
+    {
+        this->m_prune = std::move(prune);
+    }
+
+    void Scanner::scan(const std::vector<fs::path>& roots,
+        Accept accept, Receive receive) const
+    {
+        ScanState state(roots, accept, this->m_prune, this->m_cache);
+        for (unsigned i = 0; i < this->m_threads; ++i) {
+            state.queues.push_back(std::make_unique<WorkQueue>());
+        }
+        for (size_t i = 0; i < roots.size(); ++i) {
+            state.push_work(i % this->m_threads,
+                WorkItem {i, nullptr, roots[i].string()});
+        }
+        state.running = this->m_threads;
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < this->m_threads; ++i) {
+            workers.emplace_back(scan_worker, std::ref(state), i);
+        }
+        // Hand results to the receiver as they come in. Should the receiver
+        // throw, the workers are told to stop before rethrowing.
+        try {
+            while (true) {
+                std::vector<ScanEntry> batch;
+                {
+                    std::unique_lock<std::mutex> lock(state.result_mutex);
+                    state.result_cv.wait(lock, [&]() {
+                        return !state.results.empty() || state.running == 0;
+                    });
+                    if (state.results.empty()) {
+                        break;
+                    }
+                    batch = std::move(state.results.front());
+                    state.results.pop_front();
+                }
+                if (!state.failed) {
+                    for (auto& entry : batch) {
+                        receive(std::move(entry));
+                    }
+                }
+            }
+        } catch (...) {
+            state.fail(std::current_exception());
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        if (state.error) {
+            std::rethrow_exception(state.error);
+        }
+    }
+}
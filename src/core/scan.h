@@ -0,0 +1,63 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "scancache.h"
+namespace fs = boost::filesystem;
+
+namespace core {
+    /// A single file found by a Scanner.
+    struct ScanEntry {
+        /// Index of the root folder that this file was found in.
+        size_t root;
+        /// Full path of this file.
+        fs::path path;
+
+        /// Entries are ordered by root, then by path. This gives a stable
+        /// order no matter which thread happened to find a file first.
+        bool operator<(const ScanEntry& other) const;
+    };
+
+    /// Recursively finds regular files inside of a set of folders.
+    /// Folders are walked in parallel by a pool of worker threads. Each
+    /// directory is its own unit of work, and idle workers steal directories
+    /// from busy ones, so that the work is split between all input folders
+    /// and all of their subdirectories. Folders named .rbrush are skipped.
+    class Scanner {
+        unsigned m_threads;
+        ScanCache* m_cache;
+        std::function<bool(size_t, const fs::path&)> m_prune;
+    public:
+        /// Decides whether a file should be reported. It is called from
+        /// worker threads, so it must be thread safe.
+        using Accept = std::function<bool(const ScanEntry&)>;
+        /// Receives every accepted file. It is always called from the thread
+        /// that called Scanner::scan, so it does not need to be thread safe.
+        using Receive = std::function<void(ScanEntry&&)>;
+        /// Decides whether a folder should be skipped, along with everything
+        /// inside of it. It is called with the index of the root folder and
+        /// the full path of the folder, from worker threads, so it must be
+        /// thread safe.
+        using Prune = std::function<bool(size_t, const fs::path&)>;
+
+        /// Create a new scanner. A thread count of 0 uses one thread per
+        /// hardware thread.
+        Scanner(unsigned threads = 0);
+
+        /// Use a cache of directory contents while scanning. Directories
+        /// that have not changed since they were cached are not read, and
+        /// the cache is updated with every directory that was read.
+        /// The cache must outlive any scans.
+        void set_cache(ScanCache* cache);
+
+        /// Skip every folder for which prune returns true. Root folders are
+        /// never skipped.
+        void set_prune(Prune prune);
+
+        /// Scan every folder in roots.
+        /// Files are received in no particular order. If any worker throws
+        /// an exception, the scan is stopped and the exception is rethrown.
+        void scan(const std::vector<fs::path>& roots,
+            Accept accept, Receive receive) const;
+    };
+}
@@ -0,0 +1,94 @@
+#include "scancache.h"
+#include "db/batch.h"
+
+namespace core {
+    /// Join names with '/', which can never appear in a file name.
+    std::string join_names(const std::vector<std::string>& names)
+    {
+        std::string ret;
+        for (const auto& name : names) {
+            if (!ret.empty()) {
+                ret += '/';
+            }
+            ret += name;
+        }
+        return ret;
+    }
+
+    std::vector<std::string> split_names(boost::string_view str)
+    {
+        std::vector<std::string> ret;
+        size_t start = 0;
+        while (start < str.size()) {
+            size_t end = str.find('/', start);
+            if (end == boost::string_view::npos) {
+                end = str.size();
+            }
+            ret.push_back(str.substr(start, end - start).to_string());
+            start = end + 1;
+        }
+        return ret;
+    }
+
+    ScanCache ScanCache::load(database::Database& db,
+        const std::vector<fs::path>& roots)
+    {
+        ScanCache ret;
+        auto stmt = db.prepare(R"(
+            SELECT path, inode, mtime, files, dirs
+            FROM scancache
+            WHERE path = ?1
+            OR (path > ?1 || '/' AND path < ?1 || '0')
+        )");
+        for (const auto& root : roots) {
+            stmt.reset();
+            stmt.bind(1, root.string());
+            for (const auto& row : stmt.rows<std::string, int64_t, int64_t,
+                boost::string_view, boost::string_view>()) {
+                ret.m_cache.insert(std::get<0>(row), Entry {
+                    static_cast<uint64_t>(std::get<1>(row)),
+                    std::get<2>(row),
+                    split_names(std::get<3>(row)),
+                    split_names(std::get<4>(row))
+                });
+            }
+        }
+        return ret;
+    }
+
+    ScanCache::ScanCache(ScanCache&& other)
+    : m_cache(std::move(other.m_cache)) {}
+
+    const ScanCache::Entry* ScanCache::find(const std::string& path)
+    {
+        return this->m_cache.find(path);
+    }
+
+    void ScanCache::update(const std::string& path, Entry entry)
+    {
+        int64_t mtime = entry.mtime;
+        this->m_cache.update(path, mtime, std::move(entry));
+    }
+
+    void ScanCache::save(database::Database& db)
+    {
+        auto transaction = db.create_transaction();
+        database::BatchWriter inserts(db, R"(
+            INSERT OR REPLACE INTO scancache(path, inode, mtime, files, dirs)
+            VALUES )", "(?, ?, ?, ?, ?)");
+        for (const auto& pair : this->m_cache.get_updates()) {
+            inserts.add(pair.first, static_cast<int64_t>(pair.second.inode),
+                pair.second.mtime, join_names(pair.second.files),
+                join_names(pair.second.dirs));
+        }
+        inserts.flush();
+        database::BatchWriter deletes(db, R"(
+            DELETE FROM scancache
+            WHERE path IN ()", "?", ")");
+        for (const auto& path : this->m_cache.get_unvisited()) {
+            deletes.add(path);
+        }
+        deletes.flush();
+        this->m_cache.clear_updates();
+    }
+}
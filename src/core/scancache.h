@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "db/database.h"
+#include "pathcache.h"
+
+namespace core {
+    /// Remembers the contents of directories between scans.
+    /// Directories are keyed by their path, and an entry is only used while
+    /// the directory still has the same inode and modification time. Since
+    /// adding, removing or renaming an entry always updates its directory's
+    /// modification time, an unchanged directory can be listed without
+    /// reading it. Its subdirectories still need to be checked, as changes
+    /// inside of them do not affect their parent.
+    /// The cache is stored in the project database.
+    class ScanCache {
+    public:
+        /// The cached contents of a single directory.
+        struct Entry {
+            uint64_t inode;
+            int64_t mtime;
+            std::vector<std::string> files;
+            std::vector<std::string> dirs;
+        };
+    private:
+        PathCache<Entry> m_cache;
+        ScanCache() = default;
+    public:
+        /// Load the cached entries of every directory inside of roots.
+        static ScanCache load(database::Database& db,
+            const std::vector<fs::path>& roots);
+
+        ScanCache(ScanCache&& other);
+
+        /// Get the cached entry for a directory, or nullptr if there is none.
+        /// The caller must still compare the inode and modification time.
+        /// This is thread safe, and marks the directory as visited.
+        const Entry* find(const std::string& path);
+
+        /// Record the current contents of a directory. This is thread safe.
+        void update(const std::string& path, Entry entry);
+
+        /// Write every updated entry back into the database, and remove the
+        /// entries of directories inside of the roots that were not visited,
+        /// since they no longer exist.
+        void save(database::Database& db);
+    };
+}
@@ -0,0 +1,295 @@
+#include "scantable.h"
+#include <exception>
+#include <vector>
+#include <stdexcept>
+#include <thread>
+#include "queue.h"
+
+namespace core {
+    // Files are handed to the query in batches of this many, so that
+    // threads do not have to meet for every single file
+    const size_t SCAN_TABLE_BATCH_SIZE = 256;
+    // Batches a scan may find before the query has to catch up
+    const size_t SCAN_TABLE_QUEUE_SIZE = 16;
+    // Columns of rb_scan
+    const int SCAN_COLUMN_NAME = 0;
+    const int SCAN_COLUMN_PATH = 1;
+    const int SCAN_COLUMN_ROOT = 2;
+
+    const char* const ScanTable::name = "rb_scan";
+
+    namespace {
+        /// Thrown to a scan once its query no longer wants any rows.
+        struct ScanCancelled {};
+
+        struct ScanVtab {
+            sqlite3_vtab base;
+            const ScanTable* table;
+        };
+
+        /// A single running query over rb_scan. The scan runs on its own
+        /// thread, and hands batches of files to the cursor through a
+        /// bounded queue, so that only a few thousand files are ever held
+        /// at once.
+        struct ScanCursor {
+            sqlite3_vtab_cursor base;
+            std::unique_ptr<BoundedQueue<std::vector<ScanEntry>>> queue;
+            std::thread thread;
+            /// Set by the scan thread before it closes the queue.
+            std::exception_ptr error;
+            std::string root;
+            std::string name;
+            std::vector<ScanEntry> batch;
+            /// Index of the current file in batch
+            size_t index = 0;
+            sqlite3_int64 rowid = 0;
+            bool eof = true;
+
+            /// Stop the scan, if any, and wait for it to finish.
+            void stop()
+            {
+                if (this->queue) {
+                    this->queue->close();
+                }
+                if (this->thread.joinable()) {
+                    this->thread.join();
+                }
+                this->queue.reset();
+                this->error = nullptr;
+            }
+        };
+
+        void set_error(sqlite3_vtab* vtab, const char* message)
+        {
+            sqlite3_free(vtab->zErrMsg);
+            vtab->zErrMsg = sqlite3_mprintf("%s", message);
+        }
+
+        int scan_connect(sqlite3* db, void* aux, int, const char* const*,
+            sqlite3_vtab** out, char**)
+        {
+            int rc = sqlite3_declare_vtab(db, R"(
+                CREATE TABLE x(name TEXT, path TEXT, root HIDDEN)
+            )");
+            if (rc != SQLITE_OK) {
+                return rc;
+            }
+            auto vtab = new ScanVtab();
+            vtab->table = static_cast<const ScanTable*>(aux);
+            *out = &vtab->base;
+            return SQLITE_OK;
+        }
+
+        int scan_disconnect(sqlite3_vtab* vtab)
+        {
+            delete reinterpret_cast<ScanVtab*>(vtab);
+            return SQLITE_OK;
+        }
+
+        int scan_best_index(sqlite3_vtab* vtab, sqlite3_index_info* info)
+        {
+            // The folder is the only constraint that can be used, and
+            // without it there is nothing to scan.
+            bool has_root = false;
+            for (int i = 0; i < info->nConstraint; ++i) {
+                const auto& constraint = info->aConstraint[i];
+                if (constraint.iColumn != SCAN_COLUMN_ROOT) {
+                    continue;
+                }
+                if (constraint.op != SQLITE_INDEX_CONSTRAINT_EQ
+                || !constraint.usable) {
+                    return SQLITE_CONSTRAINT;
+                }
+                info->aConstraintUsage[i].argvIndex = 1;
+                info->aConstraintUsage[i].omit = 1;
+                has_root = true;
+            }
+            if (!has_root) {
+                set_error(vtab, "rb_scan needs a folder to scan");
+                return SQLITE_ERROR;
+            }
+            // Scanning is costly, so that the planner never scans a folder
+            // once for every row of another table
+            info->estimatedCost = 1e9;
+            info->estimatedRows = 1000000;
+            return SQLITE_OK;
+        }
+
+        int scan_open(sqlite3_vtab*, sqlite3_vtab_cursor** out)
+        {
+            auto cursor = new ScanCursor();
+            *out = &cursor->base;
+            return SQLITE_OK;
+        }
+
+        int scan_close(sqlite3_vtab_cursor* base)
+        {
+            auto cursor = reinterpret_cast<ScanCursor*>(base);
+            cursor->stop();
+            delete cursor;
+            return SQLITE_OK;
+        }
+
+        int scan_next(sqlite3_vtab_cursor* base)
+        {
+            auto cursor = reinterpret_cast<ScanCursor*>(base);
+            ++ cursor->index;
+            while (cursor->index >= cursor->batch.size()) {
+                cursor->index = 0;
+                if (!cursor->queue->pop(cursor->batch)) {
+                    cursor->batch.clear();
+                    break;
+                }
+            }
+            if (!cursor->batch.empty()) {
+                cursor->name = cursor->batch[cursor->index].path.filename()
+                    .string();
+                ++ cursor->rowid;
+                return SQLITE_OK;
+            }
+            cursor->eof = true;
+            if (cursor->error) {
+                try {
+                    std::rethrow_exception(cursor->error);
+                } catch (const std::exception& e) {
+                    set_error(base->pVtab, e.what());
+                } catch (...) {
+                    set_error(base->pVtab, "Unknown error while scanning");
+                }
+                return SQLITE_ERROR;
+            }
+            return SQLITE_OK;
+        }
+
+        int scan_filter(sqlite3_vtab_cursor* base, int, const char*, int,
+            sqlite3_value** argv)
+        {
+            auto cursor = reinterpret_cast<ScanCursor*>(base);
+            auto table = reinterpret_cast<ScanVtab*>(base->pVtab)->table;
+            cursor->stop();
+            cursor->rowid = 0;
+            cursor->eof = false;
+            cursor->batch.clear();
+            cursor->index = 0;
+            auto text = sqlite3_value_text(argv[0]);
+            cursor->root = text ? reinterpret_cast<const char*>(text) : "";
+            if (cursor->root.empty()) {
+                // Nothing is inside of no folder
+                cursor->eof = true;
+                return SQLITE_OK;
+            }
+            cursor->queue = std::make_unique<
+                BoundedQueue<std::vector<ScanEntry>>>(SCAN_TABLE_QUEUE_SIZE);
+            auto queue = cursor->queue.get();
+            cursor->thread = std::thread([cursor, table, queue]() {
+                std::vector<ScanEntry> batch;
+                auto push = [&]() {
+                    if (!queue->push(std::move(batch))) {
+                        throw ScanCancelled();
+                    }
+                    batch.clear();
+                };
+                try {
+                    table->get_scanner().scan({cursor->root},
+                        [](const ScanEntry&) {
+                            return true;
+                        },
+                        [&](ScanEntry&& entry) {
+                            batch.push_back(std::move(entry));
+                            if (batch.size() >= SCAN_TABLE_BATCH_SIZE) {
+                                push();
+                            }
+                        });
+                    if (!batch.empty()) {
+                        push();
+                    }
+                } catch (const ScanCancelled&) {
+                    // The query was done with the scan
+                } catch (...) {
+                    cursor->error = std::current_exception();
+                }
+                queue->close();
+            });
+            return scan_next(base);
+        }
+
+        int scan_eof(sqlite3_vtab_cursor* base)
+        {
+            return reinterpret_cast<ScanCursor*>(base)->eof;
+        }
+
+        int scan_column(sqlite3_vtab_cursor* base, sqlite3_context* context,
+            int column)
+        {
+            auto cursor = reinterpret_cast<ScanCursor*>(base);
+            const std::string* value;
+            switch (column) {
+            case SCAN_COLUMN_NAME:
+                value = &cursor->name;
+                break;
+            case SCAN_COLUMN_PATH:
+                value = &cursor->batch[cursor->index].path.native();
+                break;
+            default:
+                value = &cursor->root;
+                break;
+            }
+            sqlite3_result_text(context, value->data(), value->size(),
+                SQLITE_TRANSIENT);
+            return SQLITE_OK;
+        }
+
+        int scan_rowid(sqlite3_vtab_cursor* base, sqlite3_int64* rowid)
+        {
+            *rowid = reinterpret_cast<ScanCursor*>(base)->rowid;
+            return SQLITE_OK;
+        }
+
+        sqlite3_module make_scan_module()
+        {
+            sqlite3_module ret = {};
+            ret.iVersion = 0;
+            // No xCreate makes rb_scan an eponymous-only table, which can
+            // only be used as a table-valued function
+            ret.xConnect = scan_connect;
+            ret.xBestIndex = scan_best_index;
+            ret.xDisconnect = scan_disconnect;
+            ret.xOpen = scan_open;
+            ret.xClose = scan_close;
+            ret.xFilter = scan_filter;
+            ret.xNext = scan_next;
+            ret.xEof = scan_eof;
+            ret.xColumn = scan_column;
+            ret.xRowid = scan_rowid;
+            return ret;
+        }
+
+        const sqlite3_module scan_module = make_scan_module();
+    }
+
+    ScanTable::ScanTable(database::Database& db, unsigned threads)
+    : m_db(db.get_ptr()), m_scanner(threads)
+    {
+        int rc = sqlite3_create_module_v2(this->m_db, name, &scan_module,
+            this, nullptr);
+        if (rc != SQLITE_OK) {
+            throw std::runtime_error(sqlite3_errmsg(this->m_db));
+        }
+    }
+
+    ScanTable::~ScanTable()
+    {
+        // A null module drops the existing one
+        sqlite3_create_module_v2(this->m_db, name, nullptr, nullptr, nullptr);
+    }
+
+    void ScanTable::set_cache(ScanCache* cache)
+    {
+        this->m_scanner.set_cache(cache);
+    }
+
+    const Scanner& ScanTable::get_scanner() const
+    {
+        return this->m_scanner;
+    }
+}
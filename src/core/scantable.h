@@ -0,0 +1,42 @@
+#pragma once
+#include <memory>
+#include <sqlite3.h>
+#include "db/database.h"
+#include "scan.h"
+
+namespace core {
+    /// Makes the files found by a Scanner available to SQL, through the
+    /// table-valued function rb_scan(folder). Every file inside of folder is
+    /// a row with the columns name, the file name, and path, the full path.
+    /// A background scan feeds rows to the query as it steps, so a query
+    /// such as
+    ///     SELECT path FROM rb_scan(?) AS s JOIN images ON images.name = s.name
+    /// joins files against registered images without the scan ever being
+    /// written into the database. Rows are in no particular order.
+    /// The function exists on a connection for as long as this object does.
+    class ScanTable {
+        sqlite3* m_db;
+        Scanner m_scanner;
+    public:
+        /// Name of the table-valued function.
+        static const char* const name;
+
+        /// Register rb_scan on db. A thread count of 0 uses one thread per
+        /// hardware thread. Throws an exception if it could not be
+        /// registered.
+        ScanTable(database::Database& db, unsigned threads = 0);
+        ~ScanTable();
+        // May NOT copy or move a scan table, since SQLite holds a pointer
+        // to it
+        ScanTable(const ScanTable& other) = delete;
+        ScanTable& operator=(const ScanTable& other) = delete;
+
+        /// Use a cache of directory contents for scans started by queries.
+        /// Pass nullptr to stop using a cache. The cache must outlive any
+        /// queries that use rb_scan.
+        void set_cache(ScanCache* cache);
+
+        /// Get the scanner used by queries.
+        const Scanner& get_scanner() const;
+    };
+}
@@ -0,0 +1,214 @@
+#include "schema.h"
+#include "db/migrate.h"
+#include "db/batch.h"
+#include "texname.h"
+
+namespace core {
+    // Migrations must never be edited or removed once they have been
+    // released; add a new migration instead.
+    const std::vector<database::Migration> migrations = {
+        // 1: Initial schema. Projects created before versioning was added
+        // already have these tables, hence IF NOT EXISTS.
+        {1, [](database::Database& db) {
+            db.execute(R"(
+                CREATE TABLE IF NOT EXISTS images(
+                    name TEXT NOT NULL,
+                    alias TEXT
+                )
+            )");
+            db.execute(R"(
+                CREATE TABLE IF NOT EXISTS inputfolders(
+                    name TEXT NOT NULL UNIQUE
+                )
+            )");
+            db.execute(R"(
+                CREATE TABLE IF NOT EXISTS filters(
+                    id INTEGER PRIMARY KEY AUTOINCREMENT,
+                    type INTEGER NOT NULL,
+                    name TEXT NOT NULL,
+                    arg TEXT NOT NULL
+                )
+            )");
+        }},
+        // 2: Index image names. Older projects could end up with the same
+        // name registered more than once, so duplicates are dropped first.
+        {2, [](database::Database& db) {
+            db.execute(R"(
+                DELETE FROM images
+                WHERE rowid NOT IN (
+                    SELECT MIN(rowid) FROM images
+                    GROUP BY name
+                )
+            )");
+            db.execute(R"(
+                CREATE UNIQUE INDEX IF NOT EXISTS images_name
+                ON images(name)
+            )");
+        }},
+        // 3: Cache of directory contents, used to speed up repeated scans.
+        // files and dirs are lists of names separated by '/'.
+        {3, [](database::Database& db) {
+            db.execute(R"(
+                CREATE TABLE IF NOT EXISTS scancache(
+                    path TEXT NOT NULL PRIMARY KEY,
+                    inode INTEGER NOT NULL,
+                    mtime INTEGER NOT NULL,
+                    files TEXT NOT NULL,
+                    dirs TEXT NOT NULL
+                )
+            )");
+        }},
+        // 4: Project settings, such as the performance profile.
+        {4, [](database::Database& db) {
+            db.execute(R"(
+                CREATE TABLE IF NOT EXISTS settings(
+                    key TEXT NOT NULL PRIMARY KEY,
+                    value TEXT NOT NULL
+                )
+            )");
+        }},
+        // 5: Cache of image headers, used by filters that look at image
+        // dimensions or formats. format is an image_format_t.
+        {5, [](database::Database& db) {
+            db.execute(R"(
+                CREATE TABLE IF NOT EXISTS imageinfo(
+                    path TEXT NOT NULL PRIMARY KEY,
+                    size INTEGER NOT NULL,
+                    mtime INTEGER NOT NULL,
+                    format INTEGER NOT NULL,
+                    width INTEGER NOT NULL,
+                    height INTEGER NOT NULL,
+                    alpha INTEGER NOT NULL,
+                    paletted INTEGER NOT NULL
+                )
+            )");
+        }},
+        // 6: Remember whether images are solid. solid is an image_solid_t,
+        // and is unknown until an image has been decoded.
+        {6, [](database::Database& db) {
+            db.execute(R"(
+                ALTER TABLE imageinfo
+                ADD COLUMN solid INTEGER NOT NULL DEFAULT 0
+            )");
+        }},
+        // 7: Content hashes of images, used to find duplicates on import.
+        // hash is the XXH64 of the contents, and alias is the name of the
+        // image that a duplicate has the same contents as. Skipped
+        // duplicates are not stored in the project folder.
+        {7, [](database::Database& db) {
+            db.execute(R"(
+                ALTER TABLE images
+                ADD COLUMN size INTEGER
+            )");
+            db.execute(R"(
+                ALTER TABLE images
+                ADD COLUMN hash INTEGER
+            )");
+            db.execute(R"(
+                ALTER TABLE images
+                ADD COLUMN stored INTEGER NOT NULL DEFAULT 1
+            )");
+            db.execute(R"(
+                CREATE INDEX IF NOT EXISTS images_hash
+                ON images(hash)
+            )");
+        }},
+        // 8: Files in the project folder that share their data with another
+        // file with the same contents, written by `repaintbrush compact`.
+        // inode and mtime are those of path once it was made to share the
+        // data of source, so that it is not linked again while unchanged.
+        {8, [](database::Database& db) {
+            db.execute(R"(
+                CREATE TABLE IF NOT EXISTS compacted(
+                    path TEXT PRIMARY KEY NOT NULL,
+                    source TEXT NOT NULL,
+                    size INTEGER NOT NULL,
+                    hash INTEGER NOT NULL,
+                    inode INTEGER NOT NULL,
+                    mtime INTEGER NOT NULL
+                ) WITHOUT ROWID
+            )");
+        }},
+        // 9: Parsed names of Dolphin textures, so that filters on names can
+        // be looked up instead of parsing every name. See TextureColumns.
+        // tex_format is a texture_format_t, and mip is set for every name
+        // that ends in _mipN, Dolphin name or not.
+        {9, [](database::Database& db) {
+            db.execute(R"(
+                ALTER TABLE images
+                ADD COLUMN tex_width INTEGER
+            )");
+            db.execute(R"(
+                ALTER TABLE images
+                ADD COLUMN tex_height INTEGER
+            )");
+            db.execute(R"(
+                ALTER TABLE images
+                ADD COLUMN tex_hash INTEGER
+            )");
+            db.execute(R"(
+                ALTER TABLE images
+                ADD COLUMN tex_tlut INTEGER
+            )");
+            db.execute(R"(
+                ALTER TABLE images
+                ADD COLUMN tex_format INTEGER
+            )");
+            db.execute(R"(
+                ALTER TABLE images
+                ADD COLUMN mip INTEGER
+            )");
+            std::vector<std::string> names;
+            auto stmt = db.prepare(R"(
+                SELECT name FROM images
+            )");
+            for (const auto& row : stmt.rows<std::string>()) {
+                names.push_back(std::get<0>(row));
+            }
+            // Rows are updated by a join against a VALUES list, which is
+            // much faster than one UPDATE per name
+            database::BatchWriter updates(db, R"(
+                WITH parsed(name, width, height, hash, tlut, format, mip)
+                AS (VALUES )", "(?, ?, ?, ?, ?, ?, ?)", R"()
+                UPDATE images
+                SET (tex_width, tex_height, tex_hash, tex_tlut, tex_format,
+                    mip) = (
+                    SELECT width, height, hash, tlut, format, mip
+                    FROM parsed
+                    WHERE parsed.name = images.name)
+                WHERE name IN (SELECT name FROM parsed)
+            )");
+            for (const auto& name : names) {
+                auto columns = get_texture_columns(name);
+                if (!columns.mip && !columns.format) {
+                    continue;
+                }
+                updates.add(name, columns.width, columns.height,
+                    columns.hash, columns.tlut, columns.format, columns.mip);
+            }
+            updates.flush();
+            db.execute(R"(
+                CREATE INDEX IF NOT EXISTS images_mip
+                ON images(mip)
+                WHERE mip IS NOT NULL
+            )");
+            db.execute(R"(
+                CREATE INDEX IF NOT EXISTS images_tex_format
+                ON images(tex_format)
+                WHERE tex_format IS NOT NULL
+            )");
+            db.execute(R"(
+                CREATE INDEX IF NOT EXISTS images_tex_size
+                ON images(tex_width, tex_height)
+                WHERE tex_width IS NOT NULL
+            )");
+        }},
+    };
+
+    const int schema_version = migrations.back().version;
+
+    int migrate_project(database::Database& db)
+    {
+        return database::migrate(db, migrations);
+    }
+}
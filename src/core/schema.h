@@ -0,0 +1,12 @@
+#pragma once
+#include "db/database.h"
+
+namespace core {
+    /// The schema version that this build of Repaintbrush writes.
+    extern const int schema_version;
+
+    /// Bring a project database up to date with the current schema.
+    /// This is safe to call on new, legacy and up-to-date databases alike.
+    /// Returns the number of migrations that were applied.
+    int migrate_project(database::Database& db);
+}
@@ -0,0 +1,226 @@
+#include "solid.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <png.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SOLID_X86
+#endif
+
+namespace core {
+    namespace {
+        /// The alpha byte of an RGBA pixel, loaded as a 32 bit integer.
+        uint32_t get_alpha_mask()
+        {
+            const unsigned char bytes[4] = {0, 0, 0, 0xff};
+            uint32_t ret;
+            std::memcpy(&ret, bytes, sizeof(ret));
+            return ret;
+        }
+
+        /// Compares pixels against first, clearing uniform and transparent as
+        /// they are ruled out. Returns the number of pixels that were checked,
+        /// which may be less than count if both have been ruled out, or if the
+        /// remaining pixels do not fill a whole vector.
+        using ScanPixels = size_t(*)(const unsigned char* pixels, size_t count,
+            uint32_t first, bool& uniform, bool& transparent);
+
+        size_t scan_pixels_scalar(const unsigned char* pixels, size_t count,
+            uint32_t first, bool& uniform, bool& transparent)
+        {
+            const uint32_t alpha = get_alpha_mask();
+            for (size_t i = 0; i < count; ++i) {
+                uint32_t pixel;
+                std::memcpy(&pixel, pixels + i * 4, sizeof(pixel));
+                uniform = uniform && pixel == first;
+                transparent = transparent && (pixel & alpha) == 0;
+                if (!uniform && !transparent) {
+                    return i + 1;
+                }
+            }
+            return count;
+        }
+
+#ifdef SOLID_X86
+        __attribute__((target("sse2")))
+        size_t scan_pixels_sse2(const unsigned char* pixels, size_t count,
+            uint32_t first, bool& uniform, bool& transparent)
+        {
+            const __m128i match = _mm_set1_epi32(first);
+            const __m128i alpha = _mm_set1_epi32(get_alpha_mask());
+            const __m128i zero = _mm_setzero_si128();
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                __m128i block = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(pixels + i * 4));
+                int same = _mm_movemask_epi8(_mm_cmpeq_epi32(block, match));
+                int clear = _mm_movemask_epi8(_mm_cmpeq_epi32(
+                    _mm_and_si128(block, alpha), zero));
+                uniform = uniform && same == 0xffff;
+                transparent = transparent && clear == 0xffff;
+                if (!uniform && !transparent) {
+                    return i + 4;
+                }
+            }
+            return i;
+        }
+
+        __attribute__((target("avx2")))
+        size_t scan_pixels_avx2(const unsigned char* pixels, size_t count,
+            uint32_t first, bool& uniform, bool& transparent)
+        {
+            const __m256i match = _mm256_set1_epi32(first);
+            const __m256i alpha = _mm256_set1_epi32(get_alpha_mask());
+            const __m256i zero = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                __m256i block = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(pixels + i * 4));
+                int same = _mm256_movemask_epi8(
+                    _mm256_cmpeq_epi32(block, match));
+                int clear = _mm256_movemask_epi8(_mm256_cmpeq_epi32(
+                    _mm256_and_si256(block, alpha), zero));
+                uniform = uniform && same == -1;
+                transparent = transparent && clear == -1;
+                if (!uniform && !transparent) {
+                    return i + 8;
+                }
+            }
+            return i;
+        }
+#endif
+
+        ScanPixels get_scan_pixels()
+        {
+#ifdef SOLID_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2")) {
+                return scan_pixels_avx2;
+            }
+            if (__builtin_cpu_supports("sse2")) {
+                return scan_pixels_sse2;
+            }
+#endif
+            return scan_pixels_scalar;
+        }
+    }
+
+    SolidScan::SolidScan()
+    : m_first(0), m_started(false), m_uniform(true), m_transparent(true) {}
+
+    void SolidScan::add(const unsigned char* pixels, size_t count)
+    {
+        static const ScanPixels scan_pixels = get_scan_pixels();
+        if (count == 0 || !this->undecided()) {
+            return;
+        }
+        if (!this->m_started) {
+            std::memcpy(&this->m_first, pixels, sizeof(this->m_first));
+            this->m_started = true;
+        }
+        size_t done = scan_pixels(pixels, count, this->m_first,
+            this->m_uniform, this->m_transparent);
+        if (done < count && this->undecided()) {
+            scan_pixels_scalar(pixels + done * 4, count - done, this->m_first,
+                this->m_uniform, this->m_transparent);
+        }
+    }
+
+    bool SolidScan::undecided() const
+    {
+        return this->m_uniform || this->m_transparent;
+    }
+
+    bool SolidScan::solid() const
+    {
+        return this->m_started && this->undecided();
+    }
+
+    namespace {
+        /// Broken images are expected, so errors are not printed.
+        void on_png_error(png_structp png, png_const_charp)
+        {
+            png_longjmp(png, 1);
+        }
+
+        void on_png_warning(png_structp, png_const_charp) {}
+
+        /// Decode a PNG file into scan. libpng reports errors with longjmp,
+        /// so nothing in here may need a destructor. Returns false if the file
+        /// could not be decoded.
+        bool scan_png(FILE* file, SolidScan& scan)
+        {
+            png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING,
+                nullptr, on_png_error, on_png_warning);
+            if (!png) {
+                return false;
+            }
+            png_infop info = png_create_info_struct(png);
+            unsigned char* volatile buffer = nullptr;
+            png_bytep* volatile rows = nullptr;
+            if (!info || setjmp(png_jmpbuf(png))) {
+                std::free(rows);
+                std::free(buffer);
+                png_destroy_read_struct(&png, info ? &info : nullptr, nullptr);
+                return false;
+            }
+            png_init_io(png, file);
+            png_read_info(png, info);
+            // Convert everything to 8 bit RGBA
+            png_set_expand(png);
+            png_set_strip_16(png);
+            png_set_gray_to_rgb(png);
+            png_set_add_alpha(png, 0xff, PNG_FILLER_AFTER);
+            int passes = png_set_interlace_handling(png);
+            png_read_update_info(png, info);
+            png_uint_32 width = png_get_image_width(png, info);
+            png_uint_32 height = png_get_image_height(png, info);
+            size_t row_size = png_get_rowbytes(png, info);
+            if (passes > 1) {
+                // Rows of interlaced images are only complete after the last
+                // pass, so the whole image has to be decoded first.
+                buffer = static_cast<unsigned char*>(
+                    std::malloc(row_size * height));
+                rows = static_cast<png_bytep*>(
+                    std::malloc(sizeof(png_bytep) * height));
+                if (!buffer || !rows) {
+                    png_error(png, "out of memory");
+                }
+                for (png_uint_32 y = 0; y < height; ++y) {
+                    rows[y] = buffer + row_size * y;
+                }
+                png_read_image(png, rows);
+                scan.add(buffer, size_t(width) * height);
+            } else {
+                buffer = static_cast<unsigned char*>(std::malloc(row_size));
+                if (!buffer) {
+                    png_error(png, "out of memory");
+                }
+                for (png_uint_32 y = 0; y < height && scan.undecided(); ++y) {
+                    png_read_row(png, buffer, nullptr);
+                    scan.add(buffer, width);
+                }
+            }
+            std::free(rows);
+            std::free(buffer);
+            png_destroy_read_struct(&png, &info, nullptr);
+            return true;
+        }
+    }
+
+    image_solid_t read_image_solid(const fs::path& path, const ImageInfo& info)
+    {
+        if (info.format != IMAGE_PNG) {
+            return SOLID_NO;
+        }
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) {
+            return SOLID_NO;
+        }
+        SolidScan scan;
+        bool decoded = scan_png(file, scan);
+        std::fclose(file);
+        return decoded && scan.solid() ? SOLID_YES : SOLID_NO;
+    }
+}
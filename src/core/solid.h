@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "imageinfo.h"
+
+namespace core {
+    /// Checks whether a run of RGBA pixels is a single solid color, or is
+    /// fully transparent. Pixels are fed in any number of pieces, and the
+    /// check ends as soon as both have been ruled out.
+    /// On x86, pixels are compared with AVX2 or SSE2 when available.
+    class SolidScan {
+        uint32_t m_first;
+        bool m_started;
+        bool m_uniform;
+        bool m_transparent;
+    public:
+        SolidScan();
+
+        /// Check count pixels of 4 bytes each, in RGBA order.
+        void add(const unsigned char* pixels, size_t count);
+
+        /// Returns false once the result can no longer change.
+        bool undecided() const;
+
+        /// Returns true if every pixel so far has the same color, or every
+        /// pixel so far is fully transparent.
+        bool solid() const;
+    };
+
+    /// Decode an image and check whether it is solid. Images are decoded
+    /// one row at a time, and decoding stops at the first row that rules
+    /// out a solid image. Only PNG images are decoded; any other image, or
+    /// one that fails to decode, is SOLID_NO.
+    image_solid_t read_image_solid(const fs::path& path, const ImageInfo& info);
+}
@@ -0,0 +1,207 @@
+#include "texname.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <utility>
+
+namespace core {
+    const std::array<std::pair<texture_format_t, std::string>, 11>
+    TEXTURE_FORMAT_NAMES = {{
+        {TEXFMT_I4, "i4"},
+        {TEXFMT_I8, "i8"},
+        {TEXFMT_IA4, "ia4"},
+        {TEXFMT_IA8, "ia8"},
+        {TEXFMT_RGB565, "rgb565"},
+        {TEXFMT_RGB5A3, "rgb5a3"},
+        {TEXFMT_RGBA8, "rgba8"},
+        {TEXFMT_C4, "c4"},
+        {TEXFMT_C8, "c8"},
+        {TEXFMT_C14X2, "c14x2"},
+        {TEXFMT_CMPR, "cmpr"}
+    }};
+
+    const std::string& get_texture_format_name(texture_format_t format)
+    {
+        static const std::string none;
+        for (const auto& pair : TEXTURE_FORMAT_NAMES) {
+            if (pair.first == format) {
+                return pair.second;
+            }
+        }
+        return none;
+    }
+
+    boost::optional<texture_format_t> get_texture_format_by_name(
+        const std::string& name)
+    {
+        std::string lower = name;
+        std::transform(lower.begin(), lower.end(), lower.begin(),
+            [](unsigned char c) { return std::tolower(c); });
+        for (const auto& pair : TEXTURE_FORMAT_NAMES) {
+            if (pair.second == lower
+            || std::to_string(pair.first) == lower) {
+                return pair.first;
+            }
+        }
+        return boost::none;
+    }
+
+    namespace {
+        /// Reads the parts of a name from left to right.
+        class NameReader {
+            boost::string_view m_str;
+        public:
+            NameReader(boost::string_view str)
+            : m_str(str) {}
+
+            bool done() const
+            {
+                return m_str.empty();
+            }
+
+            /// Skip prefix if the rest of the name starts with it.
+            bool skip(boost::string_view prefix)
+            {
+                if (!m_str.starts_with(prefix)) {
+                    return false;
+                }
+                m_str.remove_prefix(prefix.size());
+                return true;
+            }
+
+            /// Read a decimal number of at most 9 digits.
+            bool decimal(uint32_t& value)
+            {
+                size_t count = 0;
+                value = 0;
+                while (count < m_str.size() && count < 9
+                && m_str[count] >= '0' && m_str[count] <= '9') {
+                    value = value * 10 + (m_str[count] - '0');
+                    ++ count;
+                }
+                m_str.remove_prefix(count);
+                return count > 0;
+            }
+
+            /// Read exactly 16 lowercase hexadecimal digits.
+            bool hex64(uint64_t& value)
+            {
+                if (m_str.size() < 16) {
+                    return false;
+                }
+                value = 0;
+                for (size_t i = 0; i < 16; ++i) {
+                    char c = m_str[i];
+                    uint64_t digit;
+                    if (c >= '0' && c <= '9') {
+                        digit = c - '0';
+                    } else if (c >= 'a' && c <= 'f') {
+                        digit = c - 'a' + 10;
+                    } else {
+                        return false;
+                    }
+                    value = (value << 4) | digit;
+                }
+                m_str.remove_prefix(16);
+                return true;
+            }
+        };
+
+        /// Get the name without its extension, the same way
+        /// fs::path::stem does.
+        boost::string_view get_stem(boost::string_view filename)
+        {
+            if (filename == "." || filename == "..") {
+                return filename;
+            }
+            return filename.substr(0, filename.rfind('.'));
+        }
+    }
+
+    boost::optional<uint32_t> get_mip_level(boost::string_view filename)
+    {
+        // ends with _mip and one or more numbers
+        boost::string_view stem = get_stem(filename);
+        size_t end = stem.size();
+        while (end > 0 && stem[end - 1] >= '0' && stem[end - 1] <= '9') {
+            -- end;
+        }
+        if (end == stem.size() || end < 4
+        || stem.substr(end - 4, 4) != "_mip") {
+            return boost::none;
+        }
+        uint64_t level = 0;
+        for (char c : stem.substr(end)) {
+            level = std::min<uint64_t>(level * 10 + (c - '0'), UINT32_MAX);
+        }
+        return static_cast<uint32_t>(level);
+    }
+
+    boost::optional<TextureName> parse_texture_name(
+        boost::string_view filename)
+    {
+        TextureName ret;
+        NameReader reader(get_stem(filename));
+        uint32_t format;
+        if (!reader.skip("tex1_") || !reader.decimal(ret.width)
+        || !reader.skip("x") || !reader.decimal(ret.height)) {
+            return boost::none;
+        }
+        ret.mipmaps = reader.skip("_m");
+        if (!reader.skip("_") || !reader.hex64(ret.hash)
+        || !reader.skip("_")) {
+            return boost::none;
+        }
+        // The palette hash is optional, and looks just like a format
+        // number would not
+        uint64_t tlut;
+        if (reader.skip("$_")) {
+            // Matches any palette
+        } else if (reader.hex64(tlut)) {
+            ret.tlut = tlut;
+            if (!reader.skip("_")) {
+                return boost::none;
+            }
+        }
+        if (!reader.decimal(format)) {
+            return boost::none;
+        }
+        auto name = get_texture_format_by_name(std::to_string(format));
+        if (!name) {
+            return boost::none;
+        }
+        ret.format = *name;
+        uint32_t mip;
+        if (reader.skip("_mip")) {
+            if (!reader.decimal(mip)) {
+                return boost::none;
+            }
+            ret.mip = mip;
+        }
+        if (!reader.done()) {
+            return boost::none;
+        }
+        return ret;
+    }
+
+    TextureColumns get_texture_columns(boost::string_view name)
+    {
+        TextureColumns ret;
+        auto mip = get_mip_level(name);
+        if (mip) {
+            ret.mip = *mip;
+        }
+        auto texture = parse_texture_name(name);
+        if (!texture) {
+            return ret;
+        }
+        ret.width = texture->width;
+        ret.height = texture->height;
+        ret.hash = static_cast<int64_t>(texture->hash);
+        if (texture->tlut) {
+            ret.tlut = static_cast<int64_t>(*texture->tlut);
+        }
+        ret.format = static_cast<int64_t>(texture->format);
+        return ret;
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <boost/optional.hpp>
+#include <boost/utility/string_view.hpp>
+
+namespace core {
+    /// Texture formats of the GameCube and Wii, numbered as in the names
+    /// of textures dumped by Dolphin.
+    enum texture_format_t {
+        TEXFMT_I4 = 0,
+        TEXFMT_I8 = 1,
+        TEXFMT_IA4 = 2,
+        TEXFMT_IA8 = 3,
+        TEXFMT_RGB565 = 4,
+        TEXFMT_RGB5A3 = 5,
+        TEXFMT_RGBA8 = 6,
+        TEXFMT_C4 = 8,
+        TEXFMT_C8 = 9,
+        TEXFMT_C14X2 = 10,
+        TEXFMT_CMPR = 14
+    };
+
+    /// Get the name of a texture format, such as "cmpr", or an empty
+    /// string if there is no such format.
+    const std::string& get_texture_format_name(texture_format_t format);
+
+    /// Get a texture format from its name or its number, or none if there
+    /// is no such format.
+    boost::optional<texture_format_t> get_texture_format_by_name(
+        const std::string& name);
+
+    /// What is encoded in the name of a texture dumped by Dolphin, which
+    /// looks like tex1_WxH[_m]_hash[_tlut]_format[_mipN].png.
+    struct TextureName {
+        /// Size of the texture in the game, which is not necessarily the
+        /// size of the image.
+        uint32_t width = 0;
+        uint32_t height = 0;
+        /// Hash of the texture data.
+        uint64_t hash = 0;
+        /// Hash of the palette, for paletted formats. Names that match any
+        /// palette have a $ instead, and no hash.
+        boost::optional<uint64_t> tlut;
+        /// True if the name has _m, which means that the texture has
+        /// mipmaps of its own.
+        bool mipmaps = false;
+        texture_format_t format = TEXFMT_I4;
+        /// Mipmap level, or none for the base texture.
+        boost::optional<uint32_t> mip;
+    };
+
+    /// Parse the file name of a texture dumped by Dolphin.
+    /// Returns none if filename is not such a name.
+    boost::optional<TextureName> parse_texture_name(
+        boost::string_view filename);
+
+    /// Get the mipmap level of a file name whose stem ends with _mip
+    /// followed by one or more digits, whether or not it is a Dolphin name.
+    /// Returns none for any other name. Levels that do not fit are clamped.
+    boost::optional<uint32_t> get_mip_level(boost::string_view filename);
+
+    /// The columns of the images table that hold the parsed name of an
+    /// image. Columns that do not apply to a name are none, which is NULL.
+    struct TextureColumns {
+        boost::optional<int64_t> width;
+        boost::optional<int64_t> height;
+        boost::optional<int64_t> hash;
+        boost::optional<int64_t> tlut;
+        boost::optional<int64_t> format;
+        boost::optional<int64_t> mip;
+    };
+
+    /// Parse a registered name into its columns of the images table.
+    TextureColumns get_texture_columns(boost::string_view name);
+}
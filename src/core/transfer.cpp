@@ -0,0 +1,279 @@
+#include "transfer.h"
+#include <cerrno>
+#include <map>
+#include <memory>
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace core {
+    const std::map<transfer_t, std::string> transfer_names = {
+        {TRANSFER_COPY, "copy"},
+        {TRANSFER_REFLINK, "reflink"},
+        {TRANSFER_RANGE, "range"},
+        {TRANSFER_HARDLINK, "hardlink"},
+        {TRANSFER_SYMLINK, "symlink"}
+    };
+
+    const std::string& get_transfer_name(transfer_t mode)
+    {
+        return transfer_names.at(mode);
+    }
+
+    boost::optional<transfer_t> get_transfer_by_name(const std::string& name)
+    {
+        for (const auto& pair : transfer_names) {
+            if (pair.second == name) {
+                return pair.first;
+            }
+        }
+        return {};
+    }
+
+#ifdef __linux__
+    // Size of the buffer used for plain copies
+    const size_t TRANSFER_BUFFER_SIZE = 128 * 1024;
+
+    fs::filesystem_error make_error(const char* what,
+        const fs::path& from, const fs::path& to)
+    {
+        return fs::filesystem_error(what, from, to,
+            boost::system::error_code(errno, boost::system::system_category()));
+    }
+
+    /// Returns true if errno means that an operation is not supported here,
+    /// as opposed to an actual failure.
+    bool is_unsupported_error(int err)
+    {
+        return err == EOPNOTSUPP || err == ENOTSUP || err == EXDEV
+            || err == EINVAL || err == ENOTTY || err == ENOSYS
+            || err == EPERM || err == EMLINK;
+    }
+
+    /// Closes a file descriptor when it goes out of scope.
+    class FileHandle {
+        int m_fd;
+    public:
+        FileHandle(int fd) : m_fd(fd) {}
+        ~FileHandle()
+        {
+            if (this->m_fd >= 0) {
+                close(this->m_fd);
+            }
+        }
+        FileHandle(const FileHandle& other) = delete;
+        FileHandle& operator=(const FileHandle& other) = delete;
+        int get() const
+        {
+            return this->m_fd;
+        }
+    };
+
+    /// Copy the remaining bytes of in to out through userspace, starting at
+    /// the given offset. Every byte that is read is also added to hasher,
+    /// if there is one.
+    void copy_data(int in, int out, off_t offset,
+        const fs::path& from, const fs::path& to, ContentHasher* hasher)
+    {
+        std::unique_ptr<char[]> buffer(new char[TRANSFER_BUFFER_SIZE]);
+        while (true) {
+            ssize_t nread = pread(in, buffer.get(), TRANSFER_BUFFER_SIZE, offset);
+            if (nread < 0) {
+                if (errno == EINTR) continue;
+                throw make_error("read", from, to);
+            }
+            if (nread == 0) {
+                return;
+            }
+            if (hasher) {
+                hasher->update(buffer.get(), nread);
+            }
+            ssize_t written = 0;
+            while (written < nread) {
+                ssize_t n = pwrite(out, buffer.get() + written,
+                    nread - written, offset + written);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    throw make_error("write", from, to);
+                }
+                written += n;
+            }
+            offset += nread;
+        }
+    }
+
+    /// Hash the whole contents of an open file.
+    ContentHash hash_fd(int fd, const fs::path& from, const fs::path& to)
+    {
+        std::unique_ptr<char[]> buffer(new char[TRANSFER_BUFFER_SIZE]);
+        ContentHasher hasher;
+        off_t offset = 0;
+        while (true) {
+            ssize_t nread = pread(fd, buffer.get(), TRANSFER_BUFFER_SIZE, offset);
+            if (nread < 0) {
+                if (errno == EINTR) continue;
+                throw make_error("read", from, to);
+            }
+            if (nread == 0) {
+                return hasher.digest();
+            }
+            hasher.update(buffer.get(), nread);
+            offset += nread;
+        }
+    }
+
+    /// Hash the whole contents of a file.
+    ContentHash hash_path(const fs::path& path, const fs::path& from,
+        const fs::path& to)
+    {
+        FileHandle in(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+        if (in.get() < 0) {
+            throw make_error("open", from, to);
+        }
+        return hash_fd(in.get(), from, to);
+    }
+
+    /// Copy the contents of a file, using the cheapest of reflink,
+    /// copy_file_range and a plain copy that works.
+    transfer_t copy_contents(const fs::path& from, const fs::path& to,
+        transfer_t mode, ContentHash* hash)
+    {
+        FileHandle in(open(from.c_str(), O_RDONLY | O_CLOEXEC));
+        if (in.get() < 0) {
+            throw make_error("open", from, to);
+        }
+        struct stat st;
+        if (fstat(in.get(), &st) != 0) {
+            throw make_error("stat", from, to);
+        }
+        FileHandle out(open(to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+            st.st_mode & 0777));
+        if (out.get() < 0) {
+            throw make_error("open", from, to);
+        }
+        try {
+            if (mode == TRANSFER_REFLINK) {
+                if (ioctl(out.get(), FICLONE, in.get()) == 0) {
+                    if (hash) {
+                        *hash = hash_fd(in.get(), from, to);
+                    }
+                    return TRANSFER_REFLINK;
+                }
+                if (!is_unsupported_error(errno)) {
+                    throw make_error("ioctl(FICLONE)", from, to);
+                }
+                mode = TRANSFER_RANGE;
+            }
+            off_t offset = 0;
+            if (mode == TRANSFER_RANGE) {
+                while (offset < st.st_size) {
+                    ssize_t n = copy_file_range(in.get(), nullptr,
+                        out.get(), nullptr, st.st_size - offset, 0);
+                    if (n < 0) {
+                        if (errno == EINTR) continue;
+                        if (!is_unsupported_error(errno)) {
+                            throw make_error("copy_file_range", from, to);
+                        }
+                        mode = TRANSFER_COPY;
+                        break;
+                    }
+                    if (n == 0) {
+                        // The file shrank while copying; finish normally
+                        mode = TRANSFER_COPY;
+                        break;
+                    }
+                    offset += n;
+                }
+                if (mode == TRANSFER_RANGE) {
+                    if (hash) {
+                        *hash = hash_fd(in.get(), from, to);
+                    }
+                    return TRANSFER_RANGE;
+                }
+            }
+            // Data that was already copied in the kernel has to be read
+            // again to be hashed.
+            ContentHasher hasher;
+            if (hash && offset > 0) {
+                *hash = hash_fd(in.get(), from, to);
+            }
+            copy_data(in.get(), out.get(), offset, from, to,
+                hash && offset == 0 ? &hasher : nullptr);
+            if (hash && offset == 0) {
+                *hash = hasher.digest();
+            }
+        } catch (...) {
+            // Do not leave half of a file behind
+            unlink(to.c_str());
+            throw;
+        }
+        return TRANSFER_COPY;
+    }
+
+    transfer_t transfer_file(const fs::path& from, const fs::path& to,
+        transfer_t mode, bool overwrite, ContentHash* hash)
+    {
+        if (overwrite) {
+            if (unlink(to.c_str()) != 0 && errno != ENOENT) {
+                throw make_error("unlink", from, to);
+            }
+        }
+        switch (mode) {
+        case TRANSFER_HARDLINK:
+            if (link(from.c_str(), to.c_str()) == 0) {
+                if (hash) {
+                    *hash = hash_path(from, from, to);
+                }
+                return TRANSFER_HARDLINK;
+            }
+            if (!is_unsupported_error(errno)) {
+                throw make_error("link", from, to);
+            }
+            return copy_contents(from, to, TRANSFER_REFLINK, hash);
+        case TRANSFER_SYMLINK:
+            if (symlink(fs::absolute(from).c_str(), to.c_str()) == 0) {
+                if (hash) {
+                    *hash = hash_path(from, from, to);
+                }
+                return TRANSFER_SYMLINK;
+            }
+            if (!is_unsupported_error(errno)) {
+                throw make_error("symlink", from, to);
+            }
+            return copy_contents(from, to, TRANSFER_COPY, hash);
+        default:
+            return copy_contents(from, to, mode, hash);
+        }
+    }
+#else
+    transfer_t transfer_file(const fs::path& from, const fs::path& to,
+        transfer_t mode, bool overwrite, ContentHash* hash)
+    {
+        if (hash) {
+            *hash = hash_file(from);
+        }
+        if (mode == TRANSFER_HARDLINK || mode == TRANSFER_SYMLINK) {
+            if (overwrite) {
+                fs::remove(to);
+            }
+            boost::system::error_code err;
+            if (mode == TRANSFER_HARDLINK) {
+                fs::create_hard_link(from, to, err);
+            } else {
+                fs::create_symlink(fs::absolute(from), to, err);
+            }
+            if (!err) {
+                return mode;
+            }
+        }
+        fs::copy_file(from, to, overwrite ?
+            fs::copy_option::overwrite_if_exists :
+            fs::copy_option::fail_if_exists);
+        return TRANSFER_COPY;
+    }
+#endif
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <boost/optional.hpp>
+#include <boost/filesystem.hpp>
+#include "hash.h"
+namespace fs = boost::filesystem;
+
+namespace core {
+    /// Method used to place a file at its destination.
+    /// Every method falls back to the next cheapest method when the file
+    /// system does not support it, and all of them end at a plain copy.
+    enum transfer_t {
+        /// Copy every byte through userspace.
+        TRANSFER_COPY = 0,
+        /// Share the source's extents (FICLONE), for copy-on-write file
+        /// systems such as btrfs and XFS. Falls back to TRANSFER_RANGE.
+        TRANSFER_REFLINK = 1,
+        /// Copy inside of the kernel with copy_file_range.
+        /// Falls back to TRANSFER_COPY.
+        TRANSFER_RANGE = 2,
+        /// Create a hard link to the source.
+        /// Falls back to TRANSFER_REFLINK.
+        TRANSFER_HARDLINK = 3,
+        /// Create a symbolic link to the source.
+        /// Falls back to TRANSFER_COPY.
+        TRANSFER_SYMLINK = 4
+    };
+
+    /// Get the name of a transfer mode.
+    const std::string& get_transfer_name(transfer_t mode);
+
+    /// Get a transfer mode from its name, or none if there is no such mode.
+    boost::optional<transfer_t> get_transfer_by_name(const std::string& name);
+
+    /// Transfer a file from one path to another.
+    /// If overwrite is false, an exception is thrown if the destination
+    /// already exists. Otherwise the destination is replaced rather than
+    /// written to, so that files that are links to the source are never
+    /// truncated.
+    /// If hash is not null, it receives the hash of the file's contents.
+    /// Plain copies hash the data as it passes through, so the file is
+    /// still only read once. Other modes never see the data, so they read
+    /// the source once more to hash it.
+    /// Returns the transfer mode that was actually used.
+    transfer_t transfer_file(const fs::path& from, const fs::path& to,
+        transfer_t mode, bool overwrite, ContentHash* hash = nullptr);
+}
@@ -0,0 +1,502 @@
+#include "uring.h"
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace core {
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+    // Files larger than this are copied with transfer_file instead, since
+    // they would hold on to a slot for many chunks.
+    const int64_t URING_MAX_FILE_SIZE = 4 * 1024 * 1024;
+    // Most bytes that a single read and write copy. Every slot keeps a
+    // buffer of at most this size, so memory stays bounded by the depth.
+    const size_t URING_CHUNK_SIZE = 128 * 1024;
+
+    const unsigned URING_OPS[] = {
+        IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ,
+        IORING_OP_WRITE, IORING_OP_CLOSE
+    };
+
+    std::runtime_error make_uring_error(const char* what)
+    {
+        return std::runtime_error(std::string(what) + ": " + strerror(errno));
+    }
+
+    /// A submission and completion queue pair.
+    class Ring {
+        int m_fd;
+        void* m_sq_ptr;
+        size_t m_sq_size;
+        void* m_cq_ptr;
+        size_t m_cq_size;
+        io_uring_sqe* m_sqes;
+        size_t m_sqes_size;
+        unsigned* m_sq_head;
+        unsigned* m_sq_tail;
+        unsigned m_sq_mask;
+        unsigned m_sq_entries;
+        unsigned* m_cq_head;
+        unsigned* m_cq_tail;
+        unsigned m_cq_mask;
+        io_uring_cqe* m_cqes;
+        unsigned m_tail; /// Local submission tail
+        unsigned m_submitted; /// Tail at the last call to submit
+    public:
+        Ring(unsigned entries)
+        : m_fd(-1), m_sq_ptr(MAP_FAILED), m_cq_ptr(MAP_FAILED)
+        , m_sqes(static_cast<io_uring_sqe*>(MAP_FAILED))
+        {
+            io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+            this->m_fd = syscall(__NR_io_uring_setup, entries, &params);
+            if (this->m_fd < 0) {
+                throw make_uring_error("io_uring_setup");
+            }
+            try {
+                this->map(params);
+            } catch (...) {
+                this->unmap();
+                throw;
+            }
+        }
+
+        ~Ring()
+        {
+            this->unmap();
+        }
+
+        Ring(const Ring& other) = delete;
+        Ring& operator=(const Ring& other) = delete;
+
+        void map(const io_uring_params& params)
+        {
+            this->m_sq_size = params.sq_off.array
+                + params.sq_entries * sizeof(unsigned);
+            this->m_cq_size = params.cq_off.cqes
+                + params.cq_entries * sizeof(io_uring_cqe);
+            bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+            if (single) {
+                this->m_sq_size = std::max(this->m_sq_size, this->m_cq_size);
+            }
+            this->m_sq_ptr = mmap(nullptr, this->m_sq_size,
+                PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                this->m_fd, IORING_OFF_SQ_RING);
+            if (this->m_sq_ptr == MAP_FAILED) {
+                throw make_uring_error("mmap");
+            }
+            if (single) {
+                this->m_cq_ptr = this->m_sq_ptr;
+            } else {
+                this->m_cq_ptr = mmap(nullptr, this->m_cq_size,
+                    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    this->m_fd, IORING_OFF_CQ_RING);
+                if (this->m_cq_ptr == MAP_FAILED) {
+                    throw make_uring_error("mmap");
+                }
+            }
+            this->m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+            this->m_sqes = static_cast<io_uring_sqe*>(mmap(nullptr,
+                this->m_sqes_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, this->m_fd, IORING_OFF_SQES));
+            if (this->m_sqes == MAP_FAILED) {
+                throw make_uring_error("mmap");
+            }
+            char* sq = static_cast<char*>(this->m_sq_ptr);
+            char* cq = static_cast<char*>(this->m_cq_ptr);
+            this->m_sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+            this->m_sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            this->m_sq_mask = *reinterpret_cast<unsigned*>(
+                sq + params.sq_off.ring_mask);
+            this->m_sq_entries = params.sq_entries;
+            // Submission slots map one to one onto the SQE array
+            unsigned* array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            for (unsigned i = 0; i < params.sq_entries; ++i) {
+                array[i] = i;
+            }
+            this->m_cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            this->m_cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            this->m_cq_mask = *reinterpret_cast<unsigned*>(
+                cq + params.cq_off.ring_mask);
+            this->m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+            this->m_tail = *this->m_sq_tail;
+            this->m_submitted = this->m_tail;
+        }
+
+        void unmap()
+        {
+            if (this->m_sqes != MAP_FAILED) {
+                munmap(this->m_sqes, this->m_sqes_size);
+            }
+            if (this->m_cq_ptr != MAP_FAILED && this->m_cq_ptr != this->m_sq_ptr) {
+                munmap(this->m_cq_ptr, this->m_cq_size);
+            }
+            if (this->m_sq_ptr != MAP_FAILED) {
+                munmap(this->m_sq_ptr, this->m_sq_size);
+            }
+            if (this->m_fd >= 0) {
+                close(this->m_fd);
+            }
+        }
+
+        /// Returns true if every operation in ops is supported.
+        bool supports(const unsigned* ops, size_t n)
+        {
+            size_t size = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+            std::unique_ptr<char[]> buffer(new char[size]());
+            auto probe = reinterpret_cast<io_uring_probe*>(buffer.get());
+            if (syscall(__NR_io_uring_register, this->m_fd,
+                    IORING_REGISTER_PROBE, probe, 256) < 0) {
+                return false;
+            }
+            for (size_t i = 0; i < n; ++i) {
+                if (ops[i] > probe->last_op
+                || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /// Get a cleared submission entry, submitting pending entries first
+        /// if the queue is full.
+        io_uring_sqe* get_sqe()
+        {
+            unsigned head = __atomic_load_n(this->m_sq_head, __ATOMIC_ACQUIRE);
+            if (this->m_tail - head >= this->m_sq_entries) {
+                this->submit(0);
+                head = __atomic_load_n(this->m_sq_head, __ATOMIC_ACQUIRE);
+            }
+            io_uring_sqe* sqe = &this->m_sqes[this->m_tail & this->m_sq_mask];
+            ++ this->m_tail;
+            std::memset(sqe, 0, sizeof(*sqe));
+            return sqe;
+        }
+
+        /// Submit pending entries, and wait for at least wait completions.
+        void submit(unsigned wait)
+        {
+            __atomic_store_n(this->m_sq_tail, this->m_tail, __ATOMIC_RELEASE);
+            unsigned count = this->m_tail - this->m_submitted;
+            while (true) {
+                int ret = syscall(__NR_io_uring_enter, this->m_fd, count, wait,
+                    wait > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+                if (ret >= 0) {
+                    count -= std::min<unsigned>(count, ret);
+                    if (count == 0) {
+                        break;
+                    }
+                } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                    throw make_uring_error("io_uring_enter");
+                }
+            }
+            this->m_submitted = this->m_tail;
+        }
+
+        /// Call func for every available completion.
+        template<typename F>
+        void reap(F func)
+        {
+            unsigned head = *this->m_cq_head;
+            unsigned tail = __atomic_load_n(this->m_cq_tail, __ATOMIC_ACQUIRE);
+            while (head != tail) {
+                const io_uring_cqe& cqe = this->m_cqes[head & this->m_cq_mask];
+                func(cqe.user_data, cqe.res);
+                ++ head;
+            }
+            __atomic_store_n(this->m_cq_head, head, __ATOMIC_RELEASE);
+        }
+    };
+
+    bool uring_available()
+    {
+        try {
+            Ring ring(4);
+            return ring.supports(URING_OPS, sizeof(URING_OPS) / sizeof(URING_OPS[0]));
+        } catch (...) {
+            return false;
+        }
+    }
+
+    namespace {
+        /// Operations that a file goes through. These are stored in the low
+        /// bits of each submission's user data.
+        enum uring_op_t {
+            OP_OPEN_SRC,
+            OP_STATX,
+            OP_OPEN_DST,
+            OP_READ,
+            OP_WRITE,
+            OP_CLOSE,
+            OP_COUNT
+        };
+
+        /// State of a single file in flight.
+        struct FileSlot {
+            size_t job;
+            bool active = false;
+            int src = -1;
+            int dst = -1;
+            int pending = 0; /// Submitted operations not yet completed
+            bool failed = false;
+            bool copied = false;
+            struct statx stx;
+            uint64_t offset = 0; /// Bytes copied so far
+            size_t chunk = 0; /// Bytes of the read and write in flight
+            ContentHasher hasher;
+            std::unique_ptr<char[]> buffer;
+            size_t buffer_size = 0;
+        };
+    }
+
+    UringTransfer::UringTransfer(unsigned depth)
+    : m_depth(depth > 0 ? depth : 1) {}
+
+    void UringTransfer::run(const std::vector<TransferJob>& jobs,
+        bool overwrite, const std::atomic<bool>& stop, Finish finish,
+        std::vector<ContentHash>* hashes) const
+    {
+        // Each file has at most two operations in flight at once
+        unsigned entries = 1;
+        while (entries < this->m_depth * 2 && entries < 4096) {
+            entries *= 2;
+        }
+        Ring ring(entries);
+        if (!ring.supports(URING_OPS, sizeof(URING_OPS) / sizeof(URING_OPS[0]))) {
+            throw std::runtime_error("io_uring does not support file copies "
+                "on this kernel");
+        }
+        std::vector<FileSlot> slots(entries / 2);
+        // The first error stops new files from being started. Files that are
+        // already in flight are still finished, since the kernel may be
+        // writing into their buffers.
+        std::exception_ptr error;
+        std::vector<size_t> free_slots;
+        for (size_t i = slots.size(); i > 0; --i) {
+            free_slots.push_back(i - 1);
+        }
+        auto submit_op = [&](size_t index, uring_op_t op) {
+            FileSlot& slot = slots[index];
+            const TransferJob& job = jobs[slot.job];
+            io_uring_sqe* sqe = ring.get_sqe();
+            sqe->user_data = index * OP_COUNT + op;
+            switch (op) {
+            case OP_OPEN_SRC:
+                sqe->opcode = IORING_OP_OPENAT;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = reinterpret_cast<uintptr_t>(job.from.c_str());
+                sqe->open_flags = O_RDONLY | O_CLOEXEC;
+                break;
+            case OP_STATX:
+                sqe->opcode = IORING_OP_STATX;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = reinterpret_cast<uintptr_t>(job.from.c_str());
+                sqe->len = STATX_MODE | STATX_SIZE;
+                sqe->off = reinterpret_cast<uintptr_t>(&slot.stx);
+                break;
+            case OP_OPEN_DST:
+                sqe->opcode = IORING_OP_OPENAT;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = reinterpret_cast<uintptr_t>(job.to.c_str());
+                sqe->len = slot.stx.stx_mode & 0777;
+                sqe->open_flags = O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC;
+                break;
+            case OP_READ:
+                sqe->opcode = IORING_OP_READ;
+                sqe->fd = slot.src;
+                sqe->addr = reinterpret_cast<uintptr_t>(slot.buffer.get());
+                sqe->len = slot.chunk;
+                sqe->off = slot.offset;
+                // A short read fails the linked write
+                sqe->flags = IOSQE_IO_LINK;
+                break;
+            case OP_WRITE:
+                sqe->opcode = IORING_OP_WRITE;
+                sqe->fd = slot.dst;
+                sqe->addr = reinterpret_cast<uintptr_t>(slot.buffer.get());
+                sqe->len = slot.chunk;
+                sqe->off = slot.offset;
+                break;
+            case OP_CLOSE:
+            case OP_COUNT:
+                break;
+            }
+            ++ slot.pending;
+        };
+        auto submit_close = [&](size_t index, int fd) {
+            io_uring_sqe* sqe = ring.get_sqe();
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->fd = fd;
+            sqe->user_data = index * OP_COUNT + OP_CLOSE;
+            ++ slots[index].pending;
+        };
+        // Called whenever a file has no operations in flight
+        auto advance = [&](size_t index) {
+            FileSlot& slot = slots[index];
+            const TransferJob& job = jobs[slot.job];
+            if (slot.failed || slot.stx.stx_size > URING_MAX_FILE_SIZE) {
+                // Clean up, then try again the slow way. transfer_file reports
+                // real errors, such as missing sources, properly.
+                if (slot.src >= 0) close(slot.src);
+                if (slot.dst >= 0) {
+                    close(slot.dst);
+                    unlink(job.to.c_str());
+                }
+                slot.src = -1;
+                slot.dst = -1;
+                try {
+                    transfer_file(job.from, job.to, TRANSFER_COPY, overwrite,
+                        hashes ? &(*hashes)[slot.job] : nullptr);
+                } catch (...) {
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                    slot.active = false;
+                    free_slots.push_back(index);
+                    return;
+                }
+            } else if (slot.src >= 0 && slot.dst >= 0 && !slot.copied) {
+                if (slot.chunk > 0) {
+                    // The chunk that was just written is still in the buffer
+                    if (hashes) {
+                        slot.hasher.update(slot.buffer.get(), slot.chunk);
+                    }
+                    slot.offset += slot.chunk;
+                    slot.chunk = 0;
+                }
+                if (slot.offset == slot.stx.stx_size) {
+                    slot.copied = true;
+                } else {
+                    slot.chunk = std::min<uint64_t>(URING_CHUNK_SIZE,
+                        slot.stx.stx_size - slot.offset);
+                    if (slot.buffer_size < slot.chunk) {
+                        slot.buffer.reset(new char[slot.chunk]);
+                        slot.buffer_size = slot.chunk;
+                    }
+                    submit_op(index, OP_READ);
+                    submit_op(index, OP_WRITE);
+                    return;
+                }
+            }
+            if (slot.copied && slot.src >= 0) {
+                if (hashes) {
+                    (*hashes)[slot.job] = slot.hasher.digest();
+                }
+                submit_close(index, slot.src);
+                submit_close(index, slot.dst);
+                slot.src = -1;
+                slot.dst = -1;
+                return;
+            }
+            slot.active = false;
+            free_slots.push_back(index);
+            finish(slot.job);
+        };
+
+        size_t next = 0;
+        size_t active = 0;
+        auto can_start = [&]() {
+            return next < jobs.size() && !stop && !error;
+        };
+        while (can_start() || active > 0) {
+            // Start as many new files as there is room for
+            while (can_start() && !free_slots.empty()) {
+                size_t index = free_slots.back();
+                free_slots.pop_back();
+                FileSlot& slot = slots[index];
+                slot.job = next++;
+                slot.active = true;
+                slot.src = -1;
+                slot.dst = -1;
+                slot.failed = false;
+                slot.copied = false;
+                slot.offset = 0;
+                slot.chunk = 0;
+                slot.hasher = ContentHasher();
+                std::memset(&slot.stx, 0, sizeof(slot.stx));
+                ++ active;
+                if (overwrite && unlink(jobs[slot.job].to.c_str()) != 0
+                && errno != ENOENT) {
+                    slot.failed = true;
+                    advance(index);
+                    -- active;
+                    continue;
+                }
+                submit_op(index, OP_OPEN_SRC);
+                submit_op(index, OP_STATX);
+            }
+            if (active == 0) {
+                continue;
+            }
+            ring.submit(1);
+            std::vector<size_t> ready;
+            ring.reap([&](uint64_t data, int res) {
+                size_t index = data / OP_COUNT;
+                auto op = static_cast<uring_op_t>(data % OP_COUNT);
+                FileSlot& slot = slots[index];
+                -- slot.pending;
+                switch (op) {
+                case OP_OPEN_SRC:
+                    if (res < 0) slot.failed = true;
+                    else slot.src = res;
+                    break;
+                case OP_STATX:
+                    if (res < 0) {
+                        slot.failed = true;
+                    } else if (!slot.failed) {
+                        // The destination's permissions come from the source
+                        submit_op(index, OP_OPEN_DST);
+                    }
+                    break;
+                case OP_OPEN_DST:
+                    if (res < 0) slot.failed = true;
+                    else slot.dst = res;
+                    break;
+                case OP_READ:
+                case OP_WRITE:
+                    if (res != int64_t(slot.chunk)) slot.failed = true;
+                    break;
+                case OP_CLOSE:
+                case OP_COUNT:
+                    break;
+                }
+                if (slot.pending == 0) {
+                    ready.push_back(index);
+                }
+            });
+            for (size_t index : ready) {
+                advance(index);
+                if (!slots[index].active) {
+                    -- active;
+                }
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+#else
+    bool uring_available()
+    {
+        return false;
+    }
+
+    UringTransfer::UringTransfer(unsigned depth)
+    : m_depth(depth) {}
+
+    void UringTransfer::run(const std::vector<TransferJob>&, bool,
+        const std::atomic<bool>&, Finish, std::vector<ContentHash>*) const
+    {
+        throw std::runtime_error("io_uring is not supported on this platform");
+    }
+#endif
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <vector>
+#include "pipeline.h"
+
+namespace core {
+    /// Returns true if the running kernel supports io_uring along with every
+    /// operation that UringTransfer needs.
+    bool uring_available();
+
+    /// Copies files with io_uring.
+    /// Every file goes through openat and statx, reads of up to 128 KiB
+    /// each linked to a write, and two closes, all of which are submitted
+    /// to the kernel without blocking, so that hundreds of small files can
+    /// be in flight at once. Each file in flight holds a buffer of at most
+    /// one read. Files larger than 4 MiB, or whose transfer fails part of
+    /// the way through, are transferred with transfer_file instead.
+    class UringTransfer {
+        unsigned m_depth;
+    public:
+        /// Receives the index of each job as soon as it has finished.
+        using Finish = std::function<void(size_t)>;
+
+        /// Create a new transfer which keeps up to depth files in flight.
+        UringTransfer(unsigned depth);
+
+        /// Copy every job, calling finish after each one.
+        /// If hashes is not null, the contents of each job are hashed from
+        /// the copy buffer, and stored at the job's index before finish is
+        /// called. hashes must already have an entry for every job.
+        /// Stops early if stop becomes true. Throws an exception if
+        /// io_uring could not be set up, or if a file could not be copied.
+        void run(const std::vector<TransferJob>& jobs, bool overwrite,
+            const std::atomic<bool>& stop, Finish finish,
+            std::vector<ContentHash>* hashes = nullptr) const;
+    };
+}
@@ -1,5 +1,9 @@
 #include "util.h"
+#include <cerrno>
 #include <iostream>
+#ifdef __linux__
+#include <sys/stat.h>
+#endif
 
 namespace core {
     boost::optional<fs::path> get_project_directory(
@@ -48,6 +52,35 @@ namespace core {
         return b_iter == b.end();
     }
 
+    FileStat get_file_stat(const fs::path& path)
+    {
+        FileStat ret;
+#ifdef __linux__
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) {
+            throw fs::filesystem_error("stat", path,
+                boost::system::error_code(errno,
+                    boost::system::system_category()));
+        }
+        ret.size = st.st_size;
+        ret.mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000
+            + st.st_mtim.tv_nsec;
+        ret.device = st.st_dev;
+        ret.inode = st.st_ino;
+#else
+        ret.size = fs::file_size(path);
+        ret.mtime = static_cast<int64_t>(fs::last_write_time(path))
+            * 1000000000;
+#endif
+        return ret;
+    }
+
+    bool FileStat::is_same_file(const FileStat& other) const
+    {
+        return this->inode != 0 && this->device == other.device
+            && this->inode == other.inode;
+    }
+
     ProjectFolderLock::ProjectFolderLock(const fs::path& path, bool force)
     : m_lockpath(path / rbrush_lock_name)
     {
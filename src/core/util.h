@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <boost/optional.hpp>
 #include <boost/filesystem.hpp>
 namespace fs = boost::filesystem;
@@ -10,6 +11,7 @@ namespace core {
     const fs::path rbrush_version_name = "VERSION";
     const fs::path rbrush_db_name = "data.db";
     const fs::path rbrush_lock_name = "LOCK";
+    const fs::path rbrush_index_name = "names.idx";
 
     /// Recursively search for a project directory, going though parents.
     /// This function returns the base folder, NOT the .rbrush folder!
@@ -24,6 +26,24 @@ namespace core {
     /// Returns true if A is within B.
     bool is_path_within_path(const fs::path& a, const fs::path& b);
 
+    /// What is needed to tell files apart without reading them.
+    struct FileStat {
+        uint64_t size = 0;
+        /// Modification time in nanoseconds since the epoch.
+        int64_t mtime = 0;
+        /// Device and inode, or 0 if unknown.
+        uint64_t device = 0;
+        uint64_t inode = 0;
+
+        /// Returns true if both are the same file, such as two hard links
+        /// to the same data.
+        bool is_same_file(const FileStat& other) const;
+    };
+
+    /// Get the size, modification time and inode of a file.
+    /// Throws fs::filesystem_error if the file can not be found.
+    FileStat get_file_stat(const fs::path& path);
+
     /// Represents a lock on a directory.
     /// Note that the constructor for this class must take a directory which
     /// must be locked, not the name of the lockfile itself.
@@ -0,0 +1,210 @@
+#include "watch.h"
+#include "util.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace core {
+#ifdef __linux__
+    // Events that the watcher cares about. Files are only reported once
+    // they are closed, so that partially written files are not imported.
+    const uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE
+        | IN_MOVE_SELF | IN_ONLYDIR;
+    // How often wait checks whether it should stop, in milliseconds, in
+    // case a signal arrives right before it starts polling.
+    const int WATCH_STOP_INTERVAL = 500;
+    // Batches are reported after at most this many delays, even if files
+    // keep arriving.
+    const int WATCH_MAX_DELAYS = 10;
+
+    std::runtime_error make_watch_error(const char* what)
+    {
+        return std::runtime_error(std::string(what) + ": " + strerror(errno));
+    }
+
+    Watcher::Watcher(const std::vector<fs::path>& roots,
+        std::chrono::milliseconds delay)
+    : m_roots(roots), m_delay(delay)
+    {
+        m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_fd < 0) {
+            throw make_watch_error("Could not start watching folders");
+        }
+        try {
+            for (size_t i = 0; i < m_roots.size(); ++i) {
+                this->add_tree(i, m_roots[i], nullptr);
+            }
+        } catch (...) {
+            close(m_fd);
+            throw;
+        }
+    }
+
+    Watcher::~Watcher()
+    {
+        close(m_fd);
+    }
+
+    void Watcher::add_tree(size_t root, const fs::path& folder,
+        std::vector<ScanEntry>* found)
+    {
+        // The watch is added before the folder is read, so that files which
+        // are added in between are reported by either one or the other.
+        int wd = inotify_add_watch(m_fd, folder.c_str(), WATCH_MASK);
+        if (wd < 0) {
+            if (errno == ENOENT || errno == ENOTDIR) {
+                // Removed again before it could be watched
+                return;
+            }
+            throw make_watch_error(("Could not watch " + folder.string())
+                .c_str());
+        }
+        // A folder that was moved keeps its watch descriptor
+        m_watches[wd] = std::make_pair(root, folder);
+        boost::system::error_code ec;
+        for (fs::directory_iterator it(folder, ec), end; !ec && it != end;
+            it.increment(ec)) {
+            const fs::path& path = it->path();
+            auto status = it->symlink_status(ec);
+            if (ec) break;
+            if (fs::is_directory(status)) {
+                if (path.filename() != rbrush_folder_name) {
+                    this->add_tree(root, path, found);
+                }
+            } else if (found && fs::is_regular_file(it->status(ec))) {
+                found->push_back(ScanEntry {root, path});
+            }
+        }
+    }
+
+    const std::vector<fs::path>& Watcher::get_roots() const
+    {
+        return m_roots;
+    }
+
+    void Watcher::read_events(std::vector<ScanEntry>& files, bool& overflow)
+    {
+        alignas(inotify_event) char buffer[64 * 1024];
+        while (true) {
+            ssize_t size = read(m_fd, buffer, sizeof(buffer));
+            if (size < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN) return;
+                throw make_watch_error("Could not read folder events");
+            }
+            for (ssize_t offset = 0; offset < size;) {
+                auto event = reinterpret_cast<const inotify_event*>(
+                    buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    overflow = true;
+                    continue;
+                }
+                auto watch = m_watches.find(event->wd);
+                if (watch == m_watches.end()) continue;
+                if (event->mask & IN_IGNORED) {
+                    m_watches.erase(watch);
+                    continue;
+                }
+                if (event->mask & IN_MOVE_SELF) {
+                    // Stop watching folders that were moved elsewhere. If
+                    // the folder was moved within a watched folder, it is
+                    // watched again under its new name.
+                    if (!fs::is_directory(watch->second.second)) {
+                        inotify_rm_watch(m_fd, event->wd);
+                    }
+                    continue;
+                }
+                if (event->len == 0) continue;
+                size_t root = watch->second.first;
+                fs::path path = watch->second.second / event->name;
+                if (event->mask & IN_ISDIR) {
+                    if (path.filename() == rbrush_folder_name) continue;
+                    // Files in a folder that was just created may still be
+                    // written, so they are reported once they are closed.
+                    // A folder that was moved in is already complete.
+                    if (event->mask & IN_MOVED_TO) {
+                        this->add_tree(root, path, &files);
+                    } else if (event->mask & IN_CREATE) {
+                        this->add_tree(root, path, nullptr);
+                    }
+                } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                    files.push_back(ScanEntry {root, path});
+                }
+            }
+        }
+    }
+
+    bool Watcher::wait(Batch& batch, const std::atomic<bool>& stop)
+    {
+        batch.files.clear();
+        batch.overflow = false;
+        auto deadline = std::chrono::steady_clock::time_point::max();
+        pollfd pfd = {m_fd, POLLIN, 0};
+        while (!stop) {
+            int timeout = WATCH_STOP_INTERVAL;
+            bool collecting = !batch.files.empty() || batch.overflow;
+            if (collecting) {
+                auto now = std::chrono::steady_clock::now();
+                if (now >= deadline) break;
+                auto left = std::chrono::duration_cast<
+                    std::chrono::milliseconds>(deadline - now);
+                timeout = std::min(m_delay, left).count();
+            }
+            int ready = poll(&pfd, 1, timeout);
+            if (ready < 0) {
+                if (errno == EINTR) continue;
+                throw make_watch_error("Could not wait for folder events");
+            }
+            if (ready == 0) {
+                // Nothing new within delay, so the batch is complete
+                if (collecting) break;
+                continue;
+            }
+            this->read_events(batch.files, batch.overflow);
+            if (!collecting && (!batch.files.empty() || batch.overflow)) {
+                deadline = std::chrono::steady_clock::now()
+                    + m_delay * WATCH_MAX_DELAYS;
+            }
+        }
+        return !stop;
+    }
+#else
+    Watcher::Watcher(const std::vector<fs::path>& roots,
+        std::chrono::milliseconds delay)
+    : m_fd(-1), m_roots(roots), m_delay(delay)
+    {
+        throw std::runtime_error(
+            "Watching folders is not supported on this platform.");
+    }
+
+    Watcher::~Watcher()
+    {
+    }
+
+    void Watcher::add_tree(size_t root, const fs::path& folder,
+        std::vector<ScanEntry>* found)
+    {
+    }
+
+    const std::vector<fs::path>& Watcher::get_roots() const
+    {
+        return m_roots;
+    }
+
+    void Watcher::read_events(std::vector<ScanEntry>& files, bool& overflow)
+    {
+    }
+
+    bool Watcher::wait(Batch& batch, const std::atomic<bool>& stop)
+    {
+        return false;
+    }
+#endif
+}
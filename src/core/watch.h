@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "scan.h"
+namespace fs = boost::filesystem;
+
+namespace core {
+    /// Watches a set of folders, and all of their subfolders, for new files.
+    /// Files are reported once they have been completely written or moved
+    /// into a folder. Folders that are created or moved into a watched
+    /// folder are watched as well. Files already inside of a folder that was
+    /// moved in are reported right away, while files inside of a created
+    /// folder are only reported once they are closed. Folders named .rbrush
+    /// are skipped.
+    class Watcher {
+        int m_fd;
+        std::vector<fs::path> m_roots;
+        std::chrono::milliseconds m_delay;
+        /// Maps each watch descriptor to its root and folder.
+        std::unordered_map<int, std::pair<size_t, fs::path>> m_watches;
+        /// Watch folder and all of its subfolders. If found is not null,
+        /// every file inside of them is added to it.
+        void add_tree(size_t root, const fs::path& folder,
+            std::vector<ScanEntry>* found);
+        /// Read all pending events, adding new files to files.
+        /// overflow is set if the kernel dropped events.
+        void read_events(std::vector<ScanEntry>& files, bool& overflow);
+    public:
+        /// New files, found within a short time of each other.
+        struct Batch {
+            std::vector<ScanEntry> files;
+            /// True if the kernel dropped events. Some files may be missing
+            /// from files, so all folders should be scanned again.
+            bool overflow = false;
+        };
+
+        /// Start watching roots. Once a file is found, Watcher::wait keeps
+        /// collecting files until none have been found for delay, so that
+        /// files that are added together are reported together.
+        /// Throws an exception if watching is not supported.
+        Watcher(const std::vector<fs::path>& roots,
+            std::chrono::milliseconds delay = std::chrono::milliseconds(200));
+        ~Watcher();
+        Watcher(const Watcher&) = delete;
+        Watcher& operator=(const Watcher&) = delete;
+
+        const std::vector<fs::path>& get_roots() const;
+
+        /// Block until new files are found, and store them into batch.
+        /// Returns false without waiting any further once stop becomes true,
+        /// which may be set from a signal handler.
+        bool wait(Batch& batch, const std::atomic<bool>& stop);
+    };
+}
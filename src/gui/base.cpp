@@ -36,7 +36,12 @@ namespace gui {
 "your project folder that have been previously imported and do not match any "
 "output filters will be exported. Note that this means that if you put an "
 "image into the project folder yourself, it will not be registered and will "
-"therefor not be included in the exporting process.";
+"therefor not be included in the exporting process.\n"
+"\n"
+"Use Project->Performance Profile to choose how the project's database trades "
+"durability for speed. The 'bulk' profile is the fastest when importing large "
+"numbers of images, while the 'durable' profile makes sure that every change "
+"is written to disk.";
 
     wxIMPLEMENT_APP_NO_MAIN(GuiApp);
     wxBEGIN_EVENT_TABLE(GuiMainFrame, wxFrame)
@@ -45,6 +50,9 @@ namespace gui {
         EVT_MENU(wxID_CLOSE, GuiMainFrame::OnFileClose)
         EVT_MENU(wxID_EXIT,  GuiMainFrame::OnFileExit)
 
+        EVT_MENU_RANGE(GuiMainFrame::EV_PROFILE,
+            GuiMainFrame::EV_PROFILE + 99, GuiMainFrame::OnProjectProfile)
+
         EVT_MENU(wxID_ABOUT, GuiMainFrame::OnAbout)
     wxEND_EVENT_TABLE()
 
@@ -69,6 +77,18 @@ namespace gui {
         menu_file->AppendSeparator();
         menu_file->Append(wxID_EXIT);
 
+        // project menu
+        wxMenu *menu_profile = new wxMenu;
+        const auto& presets = core::get_profile_presets();
+        for (size_t i = 0; i < presets.size(); ++i) {
+            wxMenuItem* item = menu_profile->AppendCheckItem(EV_PROFILE + i,
+                wxString(presets[i].first));
+            m_profile_menus.push_back(item);
+            m_proj_menus.push_back(item);
+        }
+        wxMenu *menu_project = new wxMenu;
+        menu_project->AppendSubMenu(menu_profile, "Performance &Profile");
+
         // help menu
         wxMenu *menu_help = new wxMenu;
         menu_help->Append(wxID_ABOUT);
@@ -76,6 +96,7 @@ namespace gui {
         // menu bar
         wxMenuBar *menu = new wxMenuBar;
         menu->Append(menu_file, "&File");
+        menu->Append(menu_project, "&Project");
         menu->Append(menu_help, "&Help");
         SetMenuBar(menu);
 
@@ -92,6 +113,15 @@ namespace gui {
         for (wxMenuItem* item : m_proj_menus) {
             item->Enable(do_enable);
         }
+        // Custom profiles leave every preset unchecked
+        std::string profile;
+        if (m_workspace) {
+            profile = m_workspace->get_project().get_profile_name();
+        }
+        const auto& presets = core::get_profile_presets();
+        for (size_t i = 0; i < m_profile_menus.size(); ++i) {
+            m_profile_menus[i]->Check(presets[i].first == profile);
+        }
         m_sizer->RecalcSizes();
         m_sizer->Layout();
         Refresh();
@@ -184,6 +214,21 @@ namespace gui {
         Close(true);
     }
 
+    // project menu
+    void GuiMainFrame::OnProjectProfile(wxCommandEvent& event)
+    {
+        TRYGUI({
+            if (m_workspace) {
+                const auto& preset = core::get_profile_presets().at(
+                    event.GetId() - EV_PROFILE);
+                m_workspace->get_project().set_profile(preset.first,
+                    preset.second);
+                SetStatusText("Now using the " + preset.first + " profile.");
+            }
+        })
+        update_gui();
+    }
+
     void GuiMainFrame::OnAbout(wxCommandEvent& event)
     {
         wxMessageBox(helptext,
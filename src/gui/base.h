@@ -41,12 +41,17 @@ namespace gui {
     class GuiMainFrame : public wxFrame
     {
     public:
+        enum {
+            // One ID for each preset profile, starting at this one.
+            EV_PROFILE = wxID_HIGHEST + 1,
+        };
         GuiMainFrame(const wxString& name, const wxSize& size);
         void update_gui();
     private:
         GuiWorkspace* m_workspace;
         wxSizer* m_sizer;
         std::vector<wxMenuItem*> m_proj_menus;
+        std::vector<wxMenuItem*> m_profile_menus;
 
         // helper functions
         void open_folder(const fs::path& path);
@@ -61,7 +66,7 @@ namespace gui {
         void OnFileExit(wxCommandEvent& event);
 
         // project menu
-        // nothing yet
+        void OnProjectProfile(wxCommandEvent& event);
 
         // help menu
         void OnAbout(wxCommandEvent& event);